@@ -0,0 +1,356 @@
+#pragma once
+
+#include <coroutine>
+#include <exception>
+#include <memory>
+#include "nominal.v.3.0.h"
+
+/*
+================================================================================
+ NOMINAL ASYNC
+================================================================================
+Behaviors whose per-token work can wait on I/O without blocking the broadcast.
+
+1.  **Define an Async_Behavior** whose functor is a coroutine returning Async_Task:
+    `Async_Behavior<void()> Load = { [&]() -> Async_Task {`
+    `    Async_Value<Mesh> mesh = loader.request(Load[Path]);` // Set later by the loader's thread
+    `    Load[Model] = co_await mesh;`
+    `} };`
+
+2.  **Subscribe tokens** as with any Behavior:
+    `myToken += Load;`
+
+3.  **Run it every frame**:
+    `Load();`     // Starts a task for each subscribed token that has none in flight, then resumes the ready ones
+    `Load.poll(pool);` // Resumes the ready tasks only, spread across a Thread_Pool
+
+A task runs on the thread that polls its behavior, in the context of its token, so
+`Load[Datum]` keeps working after every `co_await`. Awaitables never resume a task
+themselves: completing one queues the task, and the next poll resumes every queued
+task in one batch. `co_await next_frame;` gives up the rest of the frame.
+Coroutine frames come from a pool owned by the behavior. Take parameters by value,
+since the frame outlives the call that started it.
+================================================================================
+*/
+
+#pragma region Frames
+// -----------------------------------------------------------------------------
+// Async_Frame_Pool: Size classes of Pool_Resource blocks for coroutine frames.
+// Frames are allocated while their behavior starts a task, through the calling
+// thread's `current` pool, and return to the class they came from. Frames of other
+// coroutines, and frames larger than the biggest class, use the global heap.
+// -----------------------------------------------------------------------------
+struct Async_Frame_Pool {
+    static constexpr size_t classes = 6;     // 128 to 4096 bytes, doubling.
+    static constexpr size_t header = alignof(std::max_align_t);
+
+    // The pool frames started on this thread are drawn from, or null for the heap.
+    static Async_Frame_Pool*& current() { static thread_local Async_Frame_Pool* pool = nullptr; return pool; }
+
+    Async_Frame_Pool() {
+        for (size_t i = 0; i < classes; ++i) pools[i] = std::make_unique<Pool_Resource>(size_t(128) << i, 64);
+    }
+
+    static void* allocate(size_t bytes) {
+        Async_Frame_Pool* pool = current();
+        size_t c = pool ? size_class(bytes + header) : classes;
+        Pool_Resource* from = c < classes ? pool->pools[c].get() : nullptr;
+        void* block = from ? from->allocate(bytes + header, alignof(std::max_align_t)) : ::operator new(bytes + header);
+        *static_cast<Pool_Resource**>(block) = from;
+        return static_cast<std::byte*>(block) + header;
+    }
+    static void deallocate(void* frame, size_t bytes) {
+        void* block = static_cast<std::byte*>(frame) - header;
+        if (Pool_Resource* from = *static_cast<Pool_Resource**>(block)) from->deallocate(block, bytes + header, alignof(std::max_align_t));
+        else ::operator delete(block);
+    }
+
+private:
+    std::unique_ptr<Pool_Resource> pools[classes];
+
+    static size_t size_class(size_t bytes) {
+        size_t c = 0;
+        while (c < classes && (size_t(128) << c) < bytes) ++c;
+        return c;
+    }
+};
+#pragma endregion
+
+#pragma region Tasks
+struct Async_Queue;
+
+// -----------------------------------------------------------------------------
+// Async_Task: The return type of an Async_Behavior's coroutine.
+// A task starts suspended and belongs to the behavior that started it, which
+// resumes it until it finishes and then destroys it.
+// -----------------------------------------------------------------------------
+struct Async_Task {
+    struct promise_type {
+        Async_Queue* queue = nullptr; // Where awaitables queue the task once it may continue.
+        size_t token = 0;             // The token the task runs for.
+        bool orphaned = false;        // The token left the behavior while the task was in flight.
+        std::exception_ptr error;
+
+        Async_Task get_return_object() { return Async_Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { error = std::current_exception(); }
+
+        static void* operator new(size_t bytes) { return Async_Frame_Pool::allocate(bytes); }
+        static void operator delete(void* frame, size_t bytes) { Async_Frame_Pool::deallocate(frame, bytes); }
+    };
+    using Handle = std::coroutine_handle<promise_type>;
+
+    explicit Async_Task(Handle ihandle) : handle(ihandle) {}
+    Async_Task(Async_Task&& other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+    Async_Task& operator = (Async_Task&& other) noexcept {
+        if (this != &other) { if (handle) handle.destroy(); handle = std::exchange(other.handle, nullptr); }
+        return *this;
+    }
+    ~Async_Task() { if (handle) handle.destroy(); }
+
+    // Hands the coroutine over to its owner.
+    Handle release() { return std::exchange(handle, nullptr); }
+
+private:
+    Handle handle;
+};
+
+// -----------------------------------------------------------------------------
+// Async_Queue: The tasks of a behavior that are ready to continue.
+// Any thread may push; the polling thread takes the whole queue at once.
+// -----------------------------------------------------------------------------
+struct Async_Queue {
+    void push(Async_Task::Handle task) {
+        std::lock_guard lock(mutex);
+        ready.push_back(task);
+    }
+    // Moves every queued task into `out`, which is cleared first.
+    void take(std::vector<Async_Task::Handle>& out) {
+        out.clear();
+        std::lock_guard lock(mutex);
+        out.swap(ready);
+    }
+
+private:
+    std::mutex mutex;
+    std::vector<Async_Task::Handle> ready;
+};
+#pragma endregion
+
+#pragma region Awaitables
+// -----------------------------------------------------------------------------
+// Async_Value: A value produced later, possibly on another thread, such as the
+// result of an asset load or an RPC. Copies share one state: hand one copy to the
+// producer, which calls `set` once, and `co_await` another inside a task.
+// Only one task may wait on a value at a time.
+// -----------------------------------------------------------------------------
+template<class T>
+struct Async_Value {
+    Async_Value() : state(std::make_shared<State>()) {}
+
+    // Stores the value and queues the waiting task, if any, for the next poll.
+    void set(T ivalue) {
+        state->value = std::move(ivalue);
+        if (state->phase.exchange(Set, std::memory_order_acq_rel) == Waiting) state->waiter.promise().queue->push(state->waiter);
+    }
+    bool ready() const { return state->phase.load(std::memory_order_acquire) == Set; }
+
+    bool await_ready() const { return ready(); }
+    // Registers the task, unless the value arrived meanwhile, in which case it carries on at once.
+    bool await_suspend(Async_Task::Handle task) {
+        state->waiter = task;
+        uint8_t expected = Empty;
+        return state->phase.compare_exchange_strong(expected, Waiting, std::memory_order_acq_rel);
+    }
+    T await_resume() { return std::move(*state->value); }
+
+private:
+    enum : uint8_t { Empty, Waiting, Set };
+    struct State {
+        std::atomic<uint8_t> phase = Empty;
+        Async_Task::Handle waiter;
+        std::optional<T> value;
+    };
+    std::shared_ptr<State> state;
+};
+
+// Suspends a task until its behavior's next poll. Usage: `co_await next_frame;`
+struct Async_Next_Frame {
+    bool await_ready() const { return false; }
+    void await_suspend(Async_Task::Handle task) const { task.promise().queue->push(task); }
+    void await_resume() const {}
+};
+inline constexpr Async_Next_Frame next_frame{};
+#pragma endregion
+
+#pragma region Behavior
+template<class Signature> struct Async_Behavior;
+
+// -----------------------------------------------------------------------------
+// Async_Behavior: A Behavior whose per-token invocations are coroutines.
+// Each subscribed token has at most one task in flight. A token that leaves the
+// behavior, or is destroyed, while its task waits has the task dropped instead of
+// resumed. The broadcast starts tasks for partition 0 only; a task already in flight
+// keeps running when its token leaves that partition.
+// Starting tasks, polling and subscribing happen on one thread at a time;
+// only awaitables may be completed from other threads, and they must be completed
+// or dropped before the behavior is destroyed.
+// -----------------------------------------------------------------------------
+template<class... Args>
+struct Async_Behavior<void(Args...)> : Subscriptions<Async_Behavior<void(Args...)>>, Behavior_Context<Async_Behavior<void(Args...)>> {
+    using Subscriptions<Async_Behavior>::tokens;
+    using Subscriptions<Async_Behavior>::erase;
+    using Behavior_Context<Async_Behavior>::access;
+    using Behavior_Context<Async_Behavior>::context;
+#pragma region properties
+    std::function<Async_Task(Args...)> behavior;            // The coroutine started for each token.
+    size_t grain = 64;                                      // Tasks resumed at a time by a thread during `poll(pool)`.
+    Behavior_Stats stats;                                   // Call counts and timings, when NOMINAL_PROFILE is on.
+#pragma endregion
+
+#pragma region Core
+    Async_Behavior(std::function<Async_Task(Args...)> ibehavior, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : Subscriptions<Async_Behavior>(resource), behavior(std::move(ibehavior)) {}
+    Async_Behavior(const Async_Behavior&) = delete;
+    Async_Behavior& operator = (const Async_Behavior&) = delete;
+    ~Async_Behavior() {
+        for (Async_Task::Handle task : running) if (task) task.destroy();
+        for (Async_Task::Handle task : orphans) task.destroy();
+    }
+
+    // Unsubscribes a token, dropping its task at its next resumption. `clone` subscribes
+    // tokens without copying tasks in flight.
+    void erase(size_t token) {
+        if (tokens.erase(token) == Token_Set::npos) return;
+        this->left(token);
+        if (!busy(token)) return;
+        Async_Task::Handle& task = running[Token_Set::slot(token)];
+        task.promise().orphaned = true;
+        orphans.push_back(std::exchange(task, nullptr));
+        --flying;
+    }
+
+    // True while the token has a task in flight.
+    bool busy(size_t token) const {
+        size_t slot = Token_Set::slot(token);
+        return slot < running.size() && running[slot] && running[slot].promise().token == token;
+    }
+    // The number of tasks in flight.
+    size_t in_flight() const { return flying; }
+#pragma endregion
+
+#pragma region QOL
+    // Starts a task for a subscribed token with none in flight, to run at the next poll.
+    // Returns false if the token is not subscribed or already busy.
+    bool start(size_t token, Args... args) {
+        if (!tokens.contains(token) || busy(token)) return false;
+        Async_Frame_Pool* previous = std::exchange(Async_Frame_Pool::current(), &frames);
+        Async_Task::Handle handle;
+        try { handle = behavior(args...).release(); }
+        catch (...) { Async_Frame_Pool::current() = previous; throw; }
+        Async_Frame_Pool::current() = previous;
+        handle.promise().queue = &queue;
+        handle.promise().token = token;
+        size_t slot = Token_Set::slot(token);
+        if (slot >= running.size()) running.resize(std::max(slot + 1, running.size() * 2));
+        running[slot] = handle;
+        ++flying;
+        queue.push(handle);
+        return true;
+    }
+
+    // Starts a task for every token of partition 0 with none in flight, in ascending token
+    // order, then resumes every ready task. Returns the number of tasks still in flight.
+    size_t operator () (Args... args) {
+        tokens.sort(0);
+        for (size_t token : tokens.members(0)) start(token, args...);
+        return poll();
+    }
+
+    // Resumes every task that was ready when the poll began, on the calling thread.
+    // Returns the number of tasks still in flight. Rethrows the first exception a task
+    // let escape, after the whole batch has run.
+    size_t poll() {
+        take();
+        [[maybe_unused]] auto scope = stats.scope(batch.size());
+        size_t& current = context();
+        for (Async_Task::Handle task : batch) {
+            current = task.promise().token;
+            task.resume();
+        }
+        settle();
+        return flying;
+    }
+
+    // Resumes the ready tasks across the pool's threads. As with `Behavior::parallel`, every
+    // token must already have an entry in each datum it touches (debug builds assert it), and tokens must not join or
+    // leave containers while the tasks run. New tasks cannot start here; call `start` or the
+    // broadcast first.
+    size_t poll(Thread_Pool& pool) {
+        assert(!access.shared_writes && "A parallel Async_Behavior must not write datums shared between tokens.");
+        take();
+        [[maybe_unused]] auto scope = stats.scope(batch.size());
+        this->fit_lanes();
+        pool.parallel_for(batch.size(), grain, [&](size_t begin, size_t end) {
+            size_t& current = context();
+            for (size_t i = begin; i < end; ++i) {
+                current = batch[i].promise().token;
+                batch[i].resume();
+            }
+        });
+        settle();
+        return flying;
+    }
+#pragma endregion
+
+private:
+    Async_Frame_Pool frames;
+    Async_Queue queue;
+    std::vector<Async_Task::Handle> running;                // The task in flight for each busy token, by slot.
+    size_t flying = 0;                                      // The number of tasks in `running`.
+    std::vector<Async_Task::Handle> orphans;                // Tasks whose token left; dropped when next due.
+    std::vector<Async_Task::Handle> batch;                  // The tasks being resumed by the current poll.
+
+    // Takes the ready tasks into the batch, dropping those whose token has left.
+    void take() {
+        queue.take(batch);
+        std::erase_if(batch, [&](Async_Task::Handle task) {
+            if (!task.promise().orphaned) return false;
+            drop(task);
+            return true;
+        });
+    }
+
+    // Destroys the tasks of the batch that finished, on the polling thread. A task
+    // orphaned while it ran is still queued or waiting, and is dropped when next due.
+    void settle() {
+        std::exception_ptr error;
+        for (Async_Task::Handle task : batch) {
+            if (!task.done()) continue;
+            if (task.promise().error && !error) error = task.promise().error;
+            if (task.promise().orphaned) drop(task);
+            else { running[Token_Set::slot(task.promise().token)] = nullptr; --flying; task.destroy(); }
+        }
+        batch.clear();
+        if (error) std::rethrow_exception(error);
+    }
+
+    void drop(Async_Task::Handle task) {
+        std::erase(orphans, task);
+        task.destroy();
+    }
+};
+
+#pragma region Operator Overloads
+// Subscribes a token to an Async_Behavior. Usage: `token += async_behavior;`
+template<class... Args> void operator += (size_t& token, Async_Behavior<void(Args...)>& behavior) { behavior.insert(token); }
+// Unsubscribes a token from an Async_Behavior, dropping its task. Usage: `token -= async_behavior;`
+template<class... Args> void operator -= (size_t& token, Async_Behavior<void(Args...)>& behavior) { behavior.erase(token); }
+// Subscribes a range of tokens to an Async_Behavior. Usage: `tokens += async_behavior;`
+template<class... Args> void operator += (std::span<const size_t> tokens, Async_Behavior<void(Args...)>& behavior) { behavior.insert(tokens); }
+// Unsubscribes a range of tokens from an Async_Behavior. Usage: `tokens -= async_behavior;`
+template<class... Args> void operator -= (std::span<const size_t> tokens, Async_Behavior<void(Args...)>& behavior) { behavior.erase(tokens); }
+#pragma endregion
+#pragma endregion
@@ -0,0 +1,275 @@
+#pragma once
+
+#include <cstring>
+#include <type_traits>
+#include "nominal.v.3.0.h"
+
+/*
+================================================================================
+ NOMINAL DELTAS
+================================================================================
+Streams datum changes to replicas as compact binary messages, built on the
+datums' change logs.
+
+1.  **Leader**: name each replicated datum with a small ID, then flush every tick:
+    `Delta_Encoder out;`
+    `out.add(1, Position).add(2, Team);`
+    `send(out.flush());`
+
+2.  **Follower**: bind the same IDs and apply what arrives:
+    `Delta_Decoder in;`
+    `in.add(1, Position).add(2, Team);`
+    `in.apply(message);`
+
+A message is a sequence of batches, one per datum that changed. Each batch lists
+its tokens in ascending order as varint-coded gaps, so dense ID ranges cost about
+a byte per token plus the value. Values must be trivially copyable and are sent
+as raw bytes, so both sides need the same layout and byte order.
+================================================================================
+*/
+
+#pragma region Encoding
+// -----------------------------------------------------------------------------
+// The wire format.
+// Batch:  varint datum ID, one form byte, then the form's body.
+// Values: varint count, then per token varint((gap << 1) | removed) and, unless
+//         removed, the value bytes.
+// Pools:  varint count, then per pool varint(gap) and the value bytes; then varint
+//         count, then per token varint((gap << 1) | removed) and, unless removed, varint pool ID.
+// -----------------------------------------------------------------------------
+namespace delta {
+    enum class Form : uint8_t { Values = 0, Pools = 1 };
+
+    inline void put_varint(std::vector<uint8_t>& out, uint64_t v) {
+        while (v >= 0x80) { out.push_back(uint8_t(v) | 0x80); v >>= 7; }
+        out.push_back(uint8_t(v));
+    }
+    template<class T> void put_value(std::vector<uint8_t>& out, const T& value) {
+        size_t at = out.size();
+        out.resize(at + sizeof(T));
+        std::memcpy(out.data() + at, &value, sizeof(T));
+    }
+
+    // Reads a message front to back. Every read fails once the message runs out.
+    struct Reader {
+        const uint8_t* at;
+        const uint8_t* end;
+
+        bool varint(uint64_t& v) {
+            v = 0;
+            for (unsigned shift = 0; shift < 64 && at != end; shift += 7) {
+                uint8_t byte = *at++;
+                v |= uint64_t(byte & 0x7F) << shift;
+                if (!(byte & 0x80)) return true;
+            }
+            return false;
+        }
+        template<class T> bool value(T& out) {
+            if (size_t(end - at) < sizeof(T)) return false;
+            std::memcpy(&out, at, sizeof(T));
+            at += sizeof(T);
+            return true;
+        }
+    };
+}
+
+// -----------------------------------------------------------------------------
+// Delta_Encoder: Turns the changes of a set of datums into delta messages.
+// `add` turns on a datum's change tracking; each `flush` encodes what changed since
+// the previous one, coalesced to the latest state of each token. The encoder follows
+// each log with a cursor, so a log only forgets changes that other readers, such as
+// reactive behaviors, have handled too.
+// -----------------------------------------------------------------------------
+struct Delta_Encoder {
+    struct Source {
+        uint32_t id;
+        std::function<void(std::vector<uint8_t>&)> encode; // Appends a batch if anything changed.
+    };
+
+    std::vector<Source> sources;
+    std::vector<uint8_t> buffer; // The message built by the latest flush.
+
+    template<class T> Delta_Encoder& add(uint32_t id, Datum<T>& datum) { return add_values<T>(id, datum); }
+    template<class T> Delta_Encoder& add(uint32_t id, Dense_Datum<T>& datum) { return add_values<T>(id, datum); }
+    template<class T> Delta_Encoder& add(uint32_t id, Paged_Datum<T>& datum) { return add_values<T>(id, datum); }
+
+    // A Shared_Datum sends the values of changed pools, then tokens joining, moving and leaving.
+    template<class T> Delta_Encoder& add(uint32_t id, Shared_Datum<T>& datum) {
+        static_assert(std::is_trivially_copyable_v<T>, "Deltas need trivially copyable values.");
+        datum.track();
+        Change_Log::Cursor seen_pools = datum.pool_log.follow(), seen_tokens = datum.log.follow();
+        std::vector<std::pair<size_t, Change_Log::Kind>> changes;
+        sources.push_back({ id, [&datum, id, seen_pools, seen_tokens, changes](std::vector<uint8_t>& out) mutable {
+            if (datum.pool_log.version == *seen_pools && datum.log.version == *seen_tokens) return;
+            delta::put_varint(out, id);
+            out.push_back(uint8_t(delta::Form::Pools));
+
+            collect(datum.pool_log, *seen_pools, changes);
+            std::erase_if(changes, [](const auto& c) { return c.second == Change_Log::Kind::Removed; });
+            delta::put_varint(out, changes.size());
+            size_t previous = 0;
+            for (auto& [pool, kind] : changes) {
+                delta::put_varint(out, pool - previous);
+                delta::put_value(out, datum.data[pool - 1]);
+                previous = pool;
+            }
+
+            collect(datum.log, *seen_tokens, changes);
+            delta::put_varint(out, changes.size());
+            previous = 0;
+            for (auto& [token, kind] : changes) {
+                auto it = datum.pools.find(token);
+                delta::put_varint(out, ((token - previous) << 1) | (it == datum.pools.end()));
+                if (it != datum.pools.end()) delta::put_varint(out, it->second);
+                previous = token;
+            }
+            datum.pool_log.advance(seen_pools);
+            datum.log.advance(seen_tokens);
+        } });
+        return *this;
+    }
+
+    // Encodes everything that changed since the last flush into one message.
+    // The returned bytes stay valid until the next flush.
+    std::span<const uint8_t> flush() {
+        buffer.clear();
+        for (Source& source : sources) source.encode(buffer);
+        return buffer;
+    }
+
+private:
+    // Gathers the IDs changed since `seen` into `changes`, ascending.
+    static void collect(const Change_Log& log, size_t seen, std::vector<std::pair<size_t, Change_Log::Kind>>& changes) {
+        changes.clear();
+        log.since(seen, [&](size_t id, Change_Log::Kind kind) { changes.push_back({ id, kind }); });
+        std::sort(changes.begin(), changes.end());
+    }
+
+    template<class T, class D> Delta_Encoder& add_values(uint32_t id, D& datum) {
+        static_assert(std::is_trivially_copyable_v<T>, "Deltas need trivially copyable values.");
+        datum.track();
+        Change_Log::Cursor seen = datum.log.follow();
+        std::vector<std::pair<size_t, Change_Log::Kind>> changes;
+        sources.push_back({ id, [&datum, id, seen, changes](std::vector<uint8_t>& out) mutable {
+            if (datum.log.version == *seen) return;
+            collect(datum.log, *seen, changes);
+            datum.log.advance(seen);
+            delta::put_varint(out, id);
+            out.push_back(uint8_t(delta::Form::Values));
+            delta::put_varint(out, changes.size());
+            size_t previous = 0;
+            for (auto& [token, kind] : changes) {
+                const T* value = datum.find(token);
+                delta::put_varint(out, ((token - previous) << 1) | !value);
+                if (value) delta::put_value(out, *value);
+                previous = token;
+            }
+        } });
+        return *this;
+    }
+};
+#pragma endregion
+
+#pragma region Decoding
+// -----------------------------------------------------------------------------
+// Delta_Decoder: Applies delta messages to replica datums.
+// Each batch is decoded in full first and then applied with the bulk operations
+// (`assign`, `erase`, `join`), so a follower does one reserve per batch rather than
+// one rehash per token.
+// -----------------------------------------------------------------------------
+struct Delta_Decoder {
+    std::unordered_map<uint32_t, std::function<bool(delta::Reader&, delta::Form)>> targets;
+
+    template<class T> Delta_Decoder& add(uint32_t id, Datum<T>& datum) { return add_values<T>(id, datum); }
+    template<class T> Delta_Decoder& add(uint32_t id, Dense_Datum<T>& datum) { return add_values<T>(id, datum); }
+    template<class T> Delta_Decoder& add(uint32_t id, Paged_Datum<T>& datum) { return add_values<T>(id, datum); }
+
+    // Pools are placed first and held until the batch's tokens have moved, so a pool the
+    // leader reclaimed and reused within one tick keeps its new value here, even while
+    // its old members are still leaving it. Pools that tokens join are held too, so one
+    // emptied by earlier leaves is not reclaimed before its new members arrive. A join
+    // into a pool that is neither placed by the batch nor allocated here rejects the batch.
+    template<class T> Delta_Decoder& add(uint32_t id, Shared_Datum<T>& datum) {
+        targets[id] = [&datum, placed = std::vector<std::pair<size_t, T>>(), moved = std::vector<std::pair<size_t, size_t>>()](delta::Reader& in, delta::Form form) mutable {
+            if (form != delta::Form::Pools) return false;
+            uint64_t count, gap, pool = 0;
+            if (!in.varint(count)) return false;
+            placed.clear(); moved.clear();
+            for (uint64_t i = 0; i < count; ++i) {
+                T value;
+                if (!in.varint(gap) || !in.value(value)) return false;
+                pool += gap;
+                if (!pool) return false;
+                placed.push_back({ size_t(pool), value });
+            }
+            // Placed pools arrive in ascending order.
+            auto joinable = [&](uint64_t p) {
+                auto it = std::lower_bound(placed.begin(), placed.end(), size_t(p), [](const auto& e, size_t q) { return e.first < q; });
+                if (it != placed.end() && it->first == p) return true;
+                if (!p || p > datum.data.size()) return false;
+                return datum.refs[p - 1] || std::find(datum.free.begin(), datum.free.end(), size_t(p)) == datum.free.end();
+            };
+            if (!in.varint(count)) return false;
+            uint64_t token = 0;
+            for (uint64_t i = 0; i < count; ++i) {
+                if (!in.varint(gap)) return false;
+                token += gap >> 1;
+                pool = 0; // 0 marks a token leaving.
+                if (!(gap & 1) && (!in.varint(pool) || !joinable(pool))) return false;
+                moved.push_back({ size_t(token), size_t(pool) });
+            }
+
+            for (auto& [p, value] : placed) { datum.place(p, value); ++datum.refs[p - 1]; }
+            for (auto [t, p] : moved) if (p) ++datum.refs[p - 1];
+            for (auto [t, p] : moved) {
+                if (p) datum.join(t, p);
+                else datum.leave(t);
+            }
+            // Dropping the hold never reclaims: a joined pool keeps its new member, and a
+            // placed pool left empty stays allocated, as it is on the leader.
+            for (auto [t, p] : moved) if (p) --datum.refs[p - 1];
+            for (auto& [p, value] : placed) --datum.refs[p - 1];
+            return true;
+        };
+        return *this;
+    }
+
+    // Applies every batch of a message. Returns false if the message is malformed or
+    // names a datum that was not added; the batches before the fault stay applied.
+    bool apply(std::span<const uint8_t> message) {
+        delta::Reader in{ message.data(), message.data() + message.size() };
+        while (in.at != in.end) {
+            uint64_t id;
+            uint8_t form;
+            if (!in.varint(id) || !in.value(form)) return false;
+            auto it = targets.find(uint32_t(id));
+            if (it == targets.end() || !it->second(in, delta::Form(form))) return false;
+        }
+        return true;
+    }
+
+private:
+    template<class T, class D> Delta_Decoder& add_values(uint32_t id, D& datum) {
+        static_assert(std::is_trivially_copyable_v<T>, "Deltas need trivially copyable values.");
+        targets[id] = [&datum, tokens = std::vector<size_t>(), values = std::vector<T>(), removed = std::vector<size_t>()](delta::Reader& in, delta::Form form) mutable {
+            if (form != delta::Form::Values) return false;
+            uint64_t count, gap, token = 0;
+            if (!in.varint(count)) return false;
+            tokens.clear(); values.clear(); removed.clear();
+            for (uint64_t i = 0; i < count; ++i) {
+                if (!in.varint(gap)) return false;
+                token += gap >> 1;
+                if (gap & 1) { removed.push_back(size_t(token)); continue; }
+                T value;
+                if (!in.value(value)) return false;
+                tokens.push_back(size_t(token));
+                values.push_back(value);
+            }
+            datum.erase(std::span<const size_t>(removed));
+            datum.assign(tokens, std::span<const T>(values));
+            return true;
+        };
+        return *this;
+    }
+};
+#pragma endregion
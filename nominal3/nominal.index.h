@@ -0,0 +1,304 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <map>
+#include <utility>
+#include "nominal.v.3.0.h"
+
+/*
+================================================================================
+ NOMINAL INDEXES
+================================================================================
+Secondary indexes over datum values, so selective lookups cost O(log n + k)
+instead of a scan of the whole datum.
+
+1.  **Attach an index** to a Datum or Dense_Datum:
+    `Ordered_Index ByHealth(Health);`                      // Ranges: <, >, [lo, hi)
+    `Hash_Index ByTeam(Team);`                              // Equality
+    `Grid_Index ByPlace(Position, 8.0f, [](const Vec3& p) { return std::array{ p.x, p.y, p.z }; });`
+
+2.  **Select** tokens and use the selection like any other container in a Query:
+    `Query(ByHealth.below(10.0f), Burning).each([](size_t token, float& health, auto& burn) { ... });`
+    `for (size_t token : ByPlace.within({ 0, 0, 0 }, { 16, 16, 16 })) { ... }`
+
+An index turns on its datum's change tracking and catches up with the change log
+at the start of every selection, so `token + datum = value`, `token - datum` and
+token destruction all reach it without extra calls; writes through `find` or a
+Dense_Datum's `data` must be reported with `touch`, as for reactive behaviors.
+A selection is owned by its index and is overwritten by the next selection.
+================================================================================
+*/
+
+#pragma region Selections
+// -----------------------------------------------------------------------------
+// Selection: The tokens an index selected, together with the datum they came from.
+// In a Query it drives the walk with O(k) members and yields each token's value.
+// -----------------------------------------------------------------------------
+template<class D>
+struct Selection {
+    D* datum;
+    Token_Set tokens;
+
+    Selection(D* idatum, std::pmr::memory_resource* resource) : datum(idatum), tokens(resource) {}
+
+    bool contains(size_t token) const { return tokens.contains(token); }
+    size_t size() const { return tokens.size(); }
+    bool empty() const { return tokens.empty(); }
+    std::pmr::vector<size_t>::const_iterator begin() const { return tokens.begin(); }
+    std::pmr::vector<size_t>::const_iterator end() const { return tokens.end(); }
+};
+
+template<class D>
+struct Query_Traits<Selection<D>> {
+    static constexpr bool ordered = true;
+    static size_t size(Selection<D>& s) { return s.size(); }
+    static bool contains(Selection<D>& s, size_t token) { return s.contains(token); }
+    template<class F> static void each(Selection<D>& s, F&& f) { s.tokens.sort(); for (size_t i = 0; i < s.tokens.size(); ++i) f(s.tokens.dense[i]); }
+    static auto& get(Selection<D>& s, size_t token) { return *s.datum->find(token); }
+};
+#pragma endregion
+
+#pragma region Indexes
+// -----------------------------------------------------------------------------
+// Index: Keeps a derived index in step with its datum through the change log.
+// The derived index provides `add(token, value)` and `remove(token)`; `refresh`
+// replays every change since the last one as a removal followed, for tokens that
+// still have a value, by an addition. `Project` turns a value into the indexed key.
+// -----------------------------------------------------------------------------
+template<class Derived, class D, class Project>
+struct Index {
+    using value_type = std::remove_cvref_t<decltype(*std::declval<D&>().find(0))>;
+    using key_type = std::remove_cvref_t<std::invoke_result_t<Project&, const value_type&>>;
+
+    D& datum;
+    Project project;
+    Selection<D> selection;  // The result of the latest selection.
+    Change_Log::Cursor seen; // The datum's log version the index reflects.
+
+    Index(D& idatum, Project iproject, std::pmr::memory_resource* resource)
+        : datum(idatum), project(std::move(iproject)), selection(&idatum, resource) {}
+    Index(const Index&) = delete;
+    Index& operator = (const Index&) = delete;
+
+    // Applies the datum's changes since the last refresh. Selections call this first.
+    void refresh() {
+        if (datum.log.version == *seen) return;
+        datum.log.since(*seen, [&](size_t token, Change_Log::Kind) {
+            derived().remove(token);
+            if (const value_type* value = std::as_const(datum).find(token)) derived().add(token, project(*value));
+        });
+        datum.log.advance(seen);
+    }
+
+    // The number of indexed tokens, after catching up.
+    size_t size() { refresh(); return derived().where.size(); }
+
+protected:
+    // Indexes every current value and starts following the log. Called by the derived constructor.
+    void build() {
+        datum.track();
+        Query_Traits<D>::each(datum, [&](size_t token) { derived().add(token, project(*std::as_const(datum).find(token))); });
+        seen = datum.log.follow();
+    }
+
+    // Starts a new selection, after catching up with the datum.
+    Selection<D>& begin_selection() {
+        refresh();
+        selection.tokens.clear();
+        return selection;
+    }
+
+private:
+    Derived& derived() { return static_cast<Derived&>(*this); }
+};
+
+// -----------------------------------------------------------------------------
+// Ordered_Index: A balanced search tree over keys, for range selections.
+// Selections cost O(log n + k); each change costs O(log n).
+// Usage: `Ordered_Index ByHealth(Health); auto& low = ByHealth.below(10.0f);`
+// -----------------------------------------------------------------------------
+template<class D, class Project = std::identity>
+struct Ordered_Index : Index<Ordered_Index<D, Project>, D, Project> {
+    using Base = Index<Ordered_Index<D, Project>, D, Project>;
+    using key_type = typename Base::key_type;
+    using Tree = std::pmr::multimap<key_type, size_t>;
+
+    Tree keys;                                                      // Key -> token, in key order.
+    std::pmr::unordered_map<size_t, typename Tree::iterator> where; // Token -> its entry in `keys`.
+
+    Ordered_Index(D& idatum, Project iproject = {}, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : Base(idatum, std::move(iproject), resource), keys(resource), where(resource) { this->build(); }
+
+    // Tokens with lo <= key < hi.
+    Selection<D>& range(const key_type& lo, const key_type& hi) {
+        return collect([&] { return lo < hi ? std::pair(keys.lower_bound(lo), keys.lower_bound(hi)) : std::pair(keys.end(), keys.end()); });
+    }
+    // Tokens with key < hi.
+    Selection<D>& below(const key_type& hi) { return collect([&] { return std::pair(keys.begin(), keys.lower_bound(hi)); }); }
+    // Tokens with key > lo.
+    Selection<D>& above(const key_type& lo) { return collect([&] { return std::pair(keys.upper_bound(lo), keys.end()); }); }
+    // Tokens whose key equals `key`.
+    Selection<D>& equal(const key_type& key) { return collect([&] { return keys.equal_range(key); }); }
+
+    void add(size_t token, const key_type& key) { where[token] = keys.emplace(key, token); }
+    void remove(size_t token) {
+        auto it = where.find(token);
+        if (it == where.end()) return;
+        keys.erase(it->second);
+        where.erase(it);
+    }
+
+private:
+    // Finds the bounds only after catching up, since `refresh` may erase the entries they point at.
+    template<class Bounds> Selection<D>& collect(Bounds bounds) {
+        Selection<D>& s = this->begin_selection();
+        auto [first, last] = bounds();
+        for (; first != last; ++first) s.tokens.insert(first->second);
+        return s;
+    }
+};
+
+// -----------------------------------------------------------------------------
+// Hash_Index: A hash table over keys, for equality selections in O(1 + k).
+// Usage: `Hash_Index ByTeam(Team); auto& red = ByTeam.equal(Team::Red);`
+// -----------------------------------------------------------------------------
+template<class D, class Project = std::identity>
+struct Hash_Index : Index<Hash_Index<D, Project>, D, Project> {
+    using Base = Index<Hash_Index<D, Project>, D, Project>;
+    using key_type = typename Base::key_type;
+    using Table = std::pmr::unordered_multimap<key_type, size_t>;
+
+    Table keys;                                                      // Key -> token.
+    std::pmr::unordered_map<size_t, typename Table::iterator> where; // Token -> its entry in `keys`.
+
+    Hash_Index(D& idatum, Project iproject = {}, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : Base(idatum, std::move(iproject), resource), keys(resource), where(resource) { this->build(); }
+
+    // Tokens whose key equals `key`.
+    Selection<D>& equal(const key_type& key) {
+        Selection<D>& s = this->begin_selection();
+        auto [first, last] = keys.equal_range(key);
+        for (; first != last; ++first) s.tokens.insert(first->second);
+        return s;
+    }
+
+    void add(size_t token, const key_type& key) { where[token] = keys.emplace(key, token); }
+    void remove(size_t token) {
+        auto it = where.find(token);
+        if (it == where.end()) return;
+        keys.erase(it->second);
+        where.erase(it);
+    }
+};
+
+// -----------------------------------------------------------------------------
+// Grid_Index: A uniform grid over points, for box and radius selections.
+// `Project` maps a value to a point, a std::array of N floats (N = 2 or 3, or more).
+// A box selection visits the cells it overlaps and tests each point, so it costs
+// O(cells + k) when cells hold a few points each; choose `cell` around the typical
+// query size. Boxes covering more cells than there are points scan the points instead.
+// Usage: `Grid_Index ByPlace(Position, 8.0f, [](const Vec3& p) { return std::array{ p.x, p.y, p.z }; });`
+// -----------------------------------------------------------------------------
+template<class D, class Project>
+struct Grid_Index : Index<Grid_Index<D, Project>, D, Project> {
+    using Base = Index<Grid_Index<D, Project>, D, Project>;
+    using point_type = typename Base::key_type;
+    static constexpr size_t dimensions = std::tuple_size_v<point_type>;
+
+    struct Place { uint64_t cell; point_type point; };
+
+    float cell;                                                           // The edge length of a cell.
+    std::pmr::unordered_map<uint64_t, std::pmr::vector<size_t>> cells;     // Cell key -> tokens in it.
+    std::pmr::unordered_map<size_t, Place> where;                          // Token -> its cell and point.
+
+    Grid_Index(D& idatum, float icell, Project iproject, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : Base(idatum, std::move(iproject), resource), cell(icell), cells(resource), where(resource) {
+        assert(cell > 0 && "Grid_Index needs a positive cell size.");
+        this->build();
+    }
+
+    // Tokens whose point lies in the box lo <= p <= hi.
+    Selection<D>& within(const point_type& lo, const point_type& hi) {
+        Selection<D>& s = this->begin_selection();
+        std::array<int64_t, dimensions> from, to;
+        double count = 1;
+        for (size_t d = 0; d < dimensions; ++d) {
+            if (std::isnan(lo[d]) || std::isnan(hi[d])) return s;
+            from[d] = coordinate(lo[d]);
+            to[d] = coordinate(hi[d]);
+            if (to[d] < from[d]) return s;
+            count *= double(to[d] - from[d] + 1);
+        }
+        if (count > double(where.size())) {
+            for (auto& [token, place] : where) if (inside(place.point, lo, hi)) s.tokens.insert(token);
+            return s;
+        }
+        std::array<int64_t, dimensions> at = from;
+        for (;;) {
+            auto it = cells.find(key(at));
+            // Distinct cells may share a key, so every point is tested; the Token_Set drops repeats.
+            if (it != cells.end()) for (size_t token : it->second) if (inside(where.find(token)->second.point, lo, hi)) s.tokens.insert(token);
+            size_t d = 0;
+            while (d < dimensions && at[d] == to[d]) at[d] = from[d], ++d;
+            if (d == dimensions) break;
+            ++at[d];
+        }
+        return s;
+    }
+
+    // Tokens whose point lies within `radius` of `center`.
+    Selection<D>& near(const point_type& center, float radius) {
+        point_type lo = center, hi = center;
+        for (size_t d = 0; d < dimensions; ++d) lo[d] -= radius, hi[d] += radius;
+        Selection<D>& s = within(lo, hi);
+        for (size_t i = s.tokens.size(); i-- > 0;) {
+            const point_type& p = where.find(s.tokens.dense[i])->second.point;
+            float distance = 0;
+            for (size_t d = 0; d < dimensions; ++d) distance += (p[d] - center[d]) * (p[d] - center[d]);
+            if (distance > radius * radius) s.tokens.erase(s.tokens.dense[i]);
+        }
+        return s;
+    }
+
+    void add(size_t token, const point_type& point) {
+        std::array<int64_t, dimensions> at;
+        for (size_t d = 0; d < dimensions; ++d) at[d] = coordinate(point[d]);
+        uint64_t k = key(at);
+        cells[k].push_back(token);
+        where[token] = { k, point };
+    }
+    void remove(size_t token) {
+        auto it = where.find(token);
+        if (it == where.end()) return;
+        auto bucket = cells.find(it->second.cell);
+        auto& tokens = bucket->second;
+        size_t i = 0;
+        while (tokens[i] != token) ++i;
+        tokens[i] = tokens.back();
+        tokens.pop_back();
+        if (tokens.empty()) cells.erase(bucket);
+        where.erase(it);
+    }
+
+private:
+    static constexpr int64_t limit = int64_t(1) << 40; // Cell coordinates are clamped to +-limit.
+
+    // The cell coordinate of `v`. Infinite and far-out values land in the outermost
+    // cells; NaN lands in cell 0, where `inside` never matches it.
+    int64_t coordinate(float v) const {
+        double c = std::floor(double(v) / double(cell));
+        if (std::isnan(c)) return 0;
+        return int64_t(std::clamp(c, -double(limit), double(limit)));
+    }
+    static bool inside(const point_type& p, const point_type& lo, const point_type& hi) {
+        for (size_t d = 0; d < dimensions; ++d) if (!(p[d] >= lo[d] && p[d] <= hi[d])) return false; // Also rejects NaN.
+        return true;
+    }
+    static uint64_t key(const std::array<int64_t, dimensions>& at) {
+        uint64_t k = 0;
+        for (int64_t c : at) k = (k ^ uint64_t(c)) * 0x9E3779B97F4A7C15ull;
+        return k;
+    }
+};
+#pragma endregion
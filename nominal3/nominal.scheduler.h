@@ -0,0 +1,204 @@
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include "nominal.v.3.0.h"
+
+/*
+================================================================================
+ NOMINAL SCHEDULER
+================================================================================
+Runs a fixed set of behaviors every frame in dependency order, spreading the
+independent ones across a Thread_Pool.
+
+1.  **Declare what each behavior touches**:
+    `Move.reads(Velocity).writes(Position);`
+
+2.  **Register the behaviors**, in the order they would run by hand:
+    `Scheduler frame;`
+    `frame.add("move", Move);`
+    `frame.add("render", Render);` // Waits for Move only if their access conflicts
+
+3.  **Run a frame**, or several pipelined frames:
+    `frame.run(pool);`
+    `frame.run(pool, 2);`
+
+4.  **Inspect and profile**:
+    `std::puts(frame.plan(2).describe(frame).c_str());`
+    `std::puts(frame.report().c_str());`
+
+================================================================================
+*/
+
+#pragma region Scheduling
+// -----------------------------------------------------------------------------
+// Scheduler: Runs registered systems in dependency order.
+// A system is a callable plus the datums it reads and writes (a Behavior's `access`).
+// Conflicting systems keep their registration order; the others may run at once.
+// `plan` groups the systems of one or more consecutive frames into stages: the steps
+// of a stage run in parallel and stages run one after another. A system of frame f + 1
+// only waits for the systems of frame f it is related to (and for itself), so with
+// several frames in flight the first systems of the next frame overlap the last
+// systems of the current one.
+// Systems that only read the same datum may run at once. Reading a Datum, Dense_Datum
+// or Paged_Datum through a behavior creates a missing entry, so every token must
+// already have an entry in the datums its systems touch; debug builds assert it.
+// A behavior's access is read when the frame is planned, so declarations made after
+// `add` still count.
+// -----------------------------------------------------------------------------
+struct Scheduler {
+    struct System {
+        std::string name;
+        std::function<void()> run;
+        Access access;
+        const Access* declared = nullptr; // A behavior's own access, used instead of `access` when set.
+        std::vector<size_t> after;        // Systems this one explicitly waits for, by index.
+        std::chrono::nanoseconds last{};  // Duration of the most recent run.
+        std::chrono::nanoseconds total{}; // Accumulated duration of every run.
+        size_t runs = 0;
+    };
+
+    // One run of a system, in one of the frames a plan covers.
+    struct Step { size_t system; size_t frame; };
+
+    // The stages of one or more frames; the steps of a stage are independent.
+    struct Plan {
+        std::vector<std::vector<Step>> stages;
+        size_t frames = 0;
+
+        // Lists each stage with the names of its steps and their last durations.
+        std::string describe(const Scheduler& scheduler) const {
+            std::string text;
+            char line[160];
+            for (size_t i = 0; i < stages.size(); ++i) {
+                text += "stage " + std::to_string(i) + ":";
+                for (const Step& step : stages[i]) {
+                    const System& system = scheduler.systems[step.system];
+                    std::snprintf(line, sizeof(line), " %s[%zu] (%.3f ms)", system.name.c_str(), step.frame, double(system.last.count()) / 1e6);
+                    text += line;
+                }
+                text += "\n";
+            }
+            return text;
+        }
+    };
+
+    std::vector<System> systems;
+
+    // Registers a system and returns its index. A system that declares no access conflicts with nothing.
+    size_t add(std::string name, std::function<void()> run, Access access = {}) {
+        systems.push_back({ std::move(name), std::move(run), std::move(access), nullptr, {}, {}, {}, 0 });
+        planned.frames = 0;
+        return systems.size() - 1;
+    }
+    // Registers a behavior's broadcast along with its declared access.
+    template<class R, class Fn> size_t add(std::string name, Behavior<R(), Fn>& behavior) {
+        size_t index = add(std::move(name), [&behavior] { behavior(); });
+        systems[index].declared = &behavior.access;
+        return index;
+    }
+    // Registers a behavior that broadcasts across the pool itself.
+    template<class R, class Fn> size_t add(std::string name, Behavior<R(), Fn>& behavior, Thread_Pool& pool) {
+        size_t index = add(std::move(name), [&behavior, &pool] { behavior.parallel(pool); });
+        systems[index].declared = &behavior.access;
+        return index;
+    }
+
+    // The access a system declares: its behavior's current one, or the one given to `add`.
+    const Access& access(size_t system) const {
+        return systems[system].declared ? *systems[system].declared : systems[system].access;
+    }
+
+    // Makes a system wait for an earlier one, whatever they access.
+    Scheduler& after(size_t system, size_t dependency) {
+        assert(dependency < system && "Scheduler dependencies must be registered before their dependents.");
+        systems[system].after.push_back(dependency);
+        planned.frames = 0;
+        return *this;
+    }
+
+    // True if two systems must not overlap: they conflict, or one explicitly waits for the other.
+    bool related(size_t a, size_t b) const {
+        auto waits = [&](size_t x, size_t y) { return std::find(systems[x].after.begin(), systems[x].after.end(), y) != systems[x].after.end(); };
+        return a == b || access(a).conflicts(access(b)) || waits(a, b) || waits(b, a);
+    }
+
+    // Builds the stages for `frames` consecutive frames. Each step goes in the first stage
+    // after every step it must follow: related systems registered earlier in its frame,
+    // and related systems of the previous frame.
+    Plan plan(size_t frames = 1) const {
+        size_t n = systems.size();
+        Plan result;
+        result.frames = frames;
+        std::vector<size_t> level(n * frames, 0);
+        for (size_t f = 0; f < frames; ++f) {
+            for (size_t s = 0; s < n; ++s) {
+                size_t l = 0;
+                for (size_t a = 0; a < s; ++a) if (related(s, a)) l = std::max(l, level[f * n + a] + 1);
+                if (f) for (size_t a = 0; a < n; ++a) if (related(s, a)) l = std::max(l, level[(f - 1) * n + a] + 1);
+                level[f * n + s] = l;
+                if (l >= result.stages.size()) result.stages.resize(l + 1);
+                result.stages[l].push_back({ s, f });
+            }
+        }
+        return result;
+    }
+
+    // Runs `frames` frames, one stage at a time, with the steps of a stage spread over the pool.
+    void run(Thread_Pool& pool, size_t frames = 1) {
+        const Plan& current = cached(frames);
+        for (const std::vector<Step>& stage : current.stages) {
+            pool.parallel_for(stage.size(), 1, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) execute(stage[i].system);
+            });
+        }
+    }
+    // Runs `frames` frames on the calling thread, in plan order.
+    void run(size_t frames = 1) {
+        const Plan& current = cached(frames);
+        for (const std::vector<Step>& stage : current.stages) for (const Step& step : stage) execute(step.system);
+    }
+
+    // Lists every system with its run count and its last and average durations.
+    std::string report() const {
+        std::string text;
+        char line[160];
+        for (const System& system : systems) {
+            double last = double(system.last.count()) / 1e6;
+            double average = system.runs ? double(system.total.count()) / 1e6 / double(system.runs) : 0.0;
+            std::snprintf(line, sizeof(line), "%-24s runs %8zu   last %9.3f ms   avg %9.3f ms\n", system.name.c_str(), system.runs, last, average);
+            text += line;
+        }
+        return text;
+    }
+
+private:
+    Plan planned;                       // The last plan built by `run`; frames == 0 means it is out of date.
+    std::vector<Access> planned_access; // Every system's access when `planned` was built.
+
+    // Replans when the frame count or any system's access changed since the last plan.
+    const Plan& cached(size_t frames) {
+        bool current = planned.frames == frames && planned_access.size() == systems.size();
+        for (size_t i = 0; current && i < systems.size(); ++i) {
+            const Access& now = access(i);
+            current = now.reads == planned_access[i].reads && now.writes == planned_access[i].writes && now.shared_writes == planned_access[i].shared_writes;
+        }
+        if (current) return planned;
+        planned = plan(frames);
+        planned_access.clear();
+        for (size_t i = 0; i < systems.size(); ++i) planned_access.push_back(access(i));
+        return planned;
+    }
+
+    // Runs one system and records how long it took. A system never overlaps itself, so no locking is needed.
+    void execute(size_t index) {
+        System& system = systems[index];
+        auto start = std::chrono::steady_clock::now();
+        system.run();
+        system.last = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+        system.total += system.last;
+        ++system.runs;
+    }
+};
+#pragma endregion
@@ -0,0 +1,417 @@
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+#include <string_view>
+#include <type_traits>
+#include "nominal.v.3.0.h"
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/*
+================================================================================
+ NOMINAL SNAPSHOTS
+================================================================================
+Saves token and datum state as contiguous binary columns and reloads it through
+a memory-mapped file, so a restart is bounded by page faults rather than by
+millions of hash inserts.
+
+1.  **Write a snapshot**:
+    `Snapshot_Writer out("state.snap");`
+    `out.write(Token_Registry::global());`
+    `out.write("position", Position);`
+    `out.write("greet", Greet);`
+    `out.close();`
+
+2.  **Map it back**:
+    `Snapshot in("state.snap");`
+    `in.load(Token_Registry::global());` // Before any token is created
+    `in.load("position", Position);`     // Rebuilds the datum
+    `auto view = in.view<Vec3>("position");` // Or reads it in place, zero-copy
+
+Values must be trivially copyable. Sections are named; each holds up to three
+columns starting on 64-byte boundaries. Token IDs are stored as 64-bit integers.
+================================================================================
+*/
+
+#pragma region Format
+// -----------------------------------------------------------------------------
+// The on-disk layout: a header, the column data, and a directory of sections at the end.
+// -----------------------------------------------------------------------------
+namespace snapshot {
+    constexpr char magic[8] = { 'N', 'O', 'M', 'S', 'N', 'A', 'P', '1' };
+    constexpr size_t alignment = 64;
+
+    enum class Kind : uint32_t { Datum = 1, Dense_Datum, Shared_Datum, Static_Datum, Subscriptions, Registry };
+
+    struct Column { uint64_t offset = 0; uint64_t bytes = 0; };
+
+    struct Section {
+        char name[48] = {};
+        Kind kind = Kind::Datum;
+        uint32_t value_size = 0;
+        Column tokens;  // Token IDs, as uint64_t.
+        Column values;  // The values; pool values for a Shared_Datum, generations for the registry.
+        Column extra;   // Pool IDs per token for a Shared_Datum, free slots for the registry.
+    };
+
+    struct Header {
+        char magic[8] = {};
+        uint64_t sections = 0;
+        uint64_t directory = 0; // The file offset of the section directory.
+    };
+}
+#pragma endregion
+
+#pragma region Writing
+// -----------------------------------------------------------------------------
+// Snapshot_Writer: Writes datums, subscriptions and the token registry to a file.
+// Datum and subscription tokens are written in ascending order, so a Snapshot_View
+// can binary search them in place. Writing stops at the first I/O error, and
+// `close` reports whether everything reached the file.
+// -----------------------------------------------------------------------------
+struct Snapshot_Writer {
+    Snapshot_Writer(const char* path) : file(std::fopen(path, "wb")) {
+        snapshot::Header header;
+        ok = file && put(&header, sizeof(header));
+    }
+    ~Snapshot_Writer() { close(); }
+    Snapshot_Writer(const Snapshot_Writer&) = delete;
+    Snapshot_Writer& operator = (const Snapshot_Writer&) = delete;
+
+    // Writes a Datum as sorted tokens and the matching values.
+    template<class T> Snapshot_Writer& write(std::string_view name, Datum<T>& datum) {
+        static_assert(std::is_trivially_copyable_v<T>, "Snapshots need trivially copyable values.");
+        std::vector<std::pair<size_t, const T*>> entries;
+        entries.reserve(datum.data.size());
+        for (auto& [token, value] : datum.data) entries.push_back({ token, &value });
+        std::sort(entries.begin(), entries.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+        std::vector<uint64_t> tokens(entries.size());
+        std::vector<T> values;
+        values.reserve(entries.size());
+        for (size_t i = 0; i < entries.size(); ++i) { tokens[i] = entries[i].first; values.push_back(*entries[i].second); }
+        snapshot::Section section = begin(name, snapshot::Kind::Datum, sizeof(T));
+        section.tokens = column(tokens.data(), tokens.size() * sizeof(uint64_t));
+        section.values = column(values.data(), values.size() * sizeof(T));
+        return end(section);
+    }
+
+    // Writes a Dense_Datum's rows ordered by full token ID. The datum's own order is by
+    // slot, which differs once recycled slots carry a generation, so the rows are sorted
+    // on the way out and the datum is left as it is.
+    template<class T> Snapshot_Writer& write(std::string_view name, Dense_Datum<T>& datum) {
+        static_assert(std::is_trivially_copyable_v<T>, "Snapshots need trivially copyable values.");
+        std::vector<size_t> rows(datum.data.size());
+        for (size_t i = 0; i < rows.size(); ++i) rows[i] = i;
+        std::sort(rows.begin(), rows.end(), [&](size_t a, size_t b) { return datum.tokens.dense[a] < datum.tokens.dense[b]; });
+        std::vector<uint64_t> tokens(rows.size());
+        std::vector<T> values;
+        values.reserve(rows.size());
+        for (size_t i = 0; i < rows.size(); ++i) { tokens[i] = datum.tokens.dense[rows[i]]; values.push_back(datum.data[rows[i]]); }
+        snapshot::Section section = begin(name, snapshot::Kind::Dense_Datum, sizeof(T));
+        section.tokens = column(tokens.data(), tokens.size() * sizeof(uint64_t));
+        section.values = column(values.data(), values.size() * sizeof(T));
+        return end(section);
+    }
+
+    // Writes a Shared_Datum as its pool values plus sorted tokens and their pool IDs.
+    template<class T> Snapshot_Writer& write(std::string_view name, Shared_Datum<T>& datum) {
+        static_assert(std::is_trivially_copyable_v<T>, "Snapshots need trivially copyable values.");
+        std::vector<std::pair<size_t, size_t>> entries(datum.pools.begin(), datum.pools.end());
+        std::sort(entries.begin(), entries.end());
+        std::vector<uint64_t> tokens(entries.size()), pools(entries.size());
+        for (size_t i = 0; i < entries.size(); ++i) { tokens[i] = entries[i].first; pools[i] = entries[i].second; }
+        snapshot::Section section = begin(name, snapshot::Kind::Shared_Datum, sizeof(T));
+        section.tokens = column(tokens.data(), tokens.size() * sizeof(uint64_t));
+        section.values = column(datum.data.data(), datum.data.size() * sizeof(T));
+        section.extra = column(pools.data(), pools.size() * sizeof(uint64_t));
+        return end(section);
+    }
+
+    // Writes a Static_Datum as its single value plus its sorted subscribers.
+    template<class T> Snapshot_Writer& write(std::string_view name, Static_Datum<T>& datum) {
+        static_assert(std::is_trivially_copyable_v<T>, "Snapshots need trivially copyable values.");
+        std::vector<uint64_t> tokens(datum.tokens.begin(), datum.tokens.end());
+        std::sort(tokens.begin(), tokens.end());
+        snapshot::Section section = begin(name, snapshot::Kind::Static_Datum, sizeof(T));
+        section.tokens = column(tokens.data(), tokens.size() * sizeof(uint64_t));
+        section.values = column(&datum.data, sizeof(T));
+        return end(section);
+    }
+
+    // Writes a Behavior's subscriptions.
+    template<class R, class Fn, class... Args> Snapshot_Writer& write(std::string_view name, Behavior<R(Args...), Fn>& behavior) {
+        std::vector<uint64_t> tokens(behavior.tokens.begin(), behavior.tokens.end());
+        std::sort(tokens.begin(), tokens.end());
+        snapshot::Section section = begin(name, snapshot::Kind::Subscriptions, 0);
+        section.tokens = column(tokens.data(), tokens.size() * sizeof(uint64_t));
+        return end(section);
+    }
+
+    // Writes the registry's generations and free slots, so restored IDs stay valid.
+    Snapshot_Writer& write(Token_Registry& registry) {
+        std::vector<uint32_t> generations(registry.capacity());
+        for (size_t i = 0; i < generations.size(); ++i) generations[i] = registry.generation_at(i);
+        std::vector<size_t> slots = registry.free_slots();
+        std::vector<uint64_t> free(slots.begin(), slots.end());
+        snapshot::Section section = begin("registry", snapshot::Kind::Registry, sizeof(uint32_t));
+        section.values = column(generations.data(), generations.size() * sizeof(uint32_t));
+        section.extra = column(free.data(), free.size() * sizeof(uint64_t));
+        return end(section);
+    }
+
+    // Writes the directory, aligned like a column, and closes the file.
+    // Returns false if anything failed to write.
+    bool close() {
+        if (!file) return ok;
+        if (ok) {
+            pad();
+            snapshot::Header header;
+            std::memcpy(header.magic, snapshot::magic, sizeof(header.magic));
+            header.sections = sections.size();
+            header.directory = position;
+            ok = ok && put(sections.data(), sections.size() * sizeof(snapshot::Section))
+                && std::fseek(file, 0, SEEK_SET) == 0
+                && std::fwrite(&header, sizeof(header), 1, file) == 1;
+        }
+        ok = std::fclose(file) == 0 && ok;
+        file = nullptr;
+        return ok;
+    }
+
+    explicit operator bool () const { return ok; }
+
+private:
+    snapshot::Section begin(std::string_view name, snapshot::Kind kind, size_t value_size) {
+        assert(name.size() < sizeof(snapshot::Section::name) && "Snapshot section names are limited to 47 characters.");
+        snapshot::Section section;
+        std::memcpy(section.name, name.data(), std::min(name.size(), sizeof(section.name) - 1));
+        section.kind = kind;
+        section.value_size = uint32_t(value_size);
+        return section;
+    }
+    Snapshot_Writer& end(const snapshot::Section& section) {
+        sections.push_back(section);
+        return *this;
+    }
+
+    // Pads to the column alignment, then writes the bytes and returns where they went.
+    snapshot::Column column(const void* data, size_t bytes) {
+        pad();
+        snapshot::Column result{ position, bytes };
+        ok = ok && put(data, bytes);
+        return result;
+    }
+    void pad() {
+        static constexpr char zeros[snapshot::alignment] = {};
+        size_t padding = (snapshot::alignment - position % snapshot::alignment) % snapshot::alignment;
+        ok = ok && put(zeros, padding);
+    }
+    bool put(const void* data, size_t bytes) {
+        if (bytes && std::fwrite(data, 1, bytes, file) != bytes) return false;
+        position += bytes;
+        return true;
+    }
+
+    std::FILE* file = nullptr;
+    uint64_t position = 0;
+    bool ok = false;
+    std::vector<snapshot::Section> sections;
+};
+#pragma endregion
+
+#pragma region Reading
+// -----------------------------------------------------------------------------
+// Snapshot_View: A datum's tokens and values read in place from a mapped snapshot.
+// Tokens are ascending, so `find` is a binary search. For a Shared_Datum the
+// values are per pool and `pools` maps each token to its pool ID.
+// Valid while the Snapshot it came from is open.
+// -----------------------------------------------------------------------------
+template<class T>
+struct Snapshot_View {
+    std::span<const uint64_t> tokens;
+    std::span<const T> values;
+    std::span<const uint64_t> pools;
+
+    const T* find(size_t token) const {
+        auto it = std::lower_bound(tokens.begin(), tokens.end(), uint64_t(token));
+        if (it == tokens.end() || *it != token) return nullptr;
+        size_t i = size_t(it - tokens.begin());
+        if (!pools.empty()) return &values[size_t(pools[i]) - 1];
+        return values.size() == 1 ? &values[0] : &values[i]; // A Static_Datum stores one value for all.
+    }
+    bool contains(size_t token) const { return std::binary_search(tokens.begin(), tokens.end(), uint64_t(token)); }
+    size_t size() const { return tokens.size(); }
+};
+
+// -----------------------------------------------------------------------------
+// Snapshot: A snapshot file mapped read-only into memory.
+// `view` reads a section in place; `load` rebuilds a container from it, reserving
+// everything up front. A missing section, a kind or value size that does not match,
+// or a file that is not a snapshot makes `load` return false and `view` come back empty.
+// -----------------------------------------------------------------------------
+struct Snapshot {
+    Snapshot(const char* path) {
+#if defined(_WIN32)
+        HANDLE handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (handle == INVALID_HANDLE_VALUE) return;
+        LARGE_INTEGER length;
+        if (GetFileSizeEx(handle, &length) && length.QuadPart > 0) {
+            HANDLE mapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (mapping) {
+                base = static_cast<const std::byte*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+                CloseHandle(mapping);
+                if (base) size = size_t(length.QuadPart);
+            }
+        }
+        CloseHandle(handle);
+#else
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0) return;
+        struct stat info;
+        if (::fstat(fd, &info) == 0 && info.st_size > 0) {
+            void* p = ::mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED) { base = static_cast<const std::byte*>(p); size = size_t(info.st_size); }
+        }
+        ::close(fd);
+#endif
+        if (!base) return;
+        const snapshot::Header* header = reinterpret_cast<const snapshot::Header*>(base);
+        valid = size >= sizeof(snapshot::Header)
+            && std::memcmp(header->magic, snapshot::magic, sizeof(snapshot::magic)) == 0
+            && header->directory <= size
+            && header->directory % alignof(snapshot::Section) == 0
+            && header->sections <= (size - header->directory) / sizeof(snapshot::Section);
+        if (valid) sections = std::span<const snapshot::Section>(reinterpret_cast<const snapshot::Section*>(base + header->directory), size_t(header->sections));
+    }
+    ~Snapshot() {
+        if (!base) return;
+#if defined(_WIN32)
+        UnmapViewOfFile(base);
+#else
+        ::munmap(const_cast<std::byte*>(base), size);
+#endif
+    }
+    Snapshot(const Snapshot&) = delete;
+    Snapshot& operator = (const Snapshot&) = delete;
+
+    // True if the file was mapped and looks like a snapshot.
+    explicit operator bool () const { return valid; }
+
+    // Returns the named section, or nullptr.
+    const snapshot::Section* find(std::string_view name) const {
+        for (const snapshot::Section& section : sections) {
+            if (name == std::string_view(section.name, strnlen(section.name, sizeof(section.name)))) return &section;
+        }
+        return nullptr;
+    }
+
+    // Reads a datum's section in place, without copying.
+    template<class T> Snapshot_View<T> view(std::string_view name) const {
+        const snapshot::Section* section = find(name);
+        if (!section || section->value_size != sizeof(T) || section->kind == snapshot::Kind::Subscriptions || section->kind == snapshot::Kind::Registry) return {};
+        return { column<uint64_t>(section->tokens), column<T>(section->values), column<uint64_t>(section->extra) };
+    }
+
+    // Adds the saved values to a datum, overwriting those of tokens it already has.
+    template<class T> bool load(std::string_view name, Datum<T>& datum) const { return load_values<T>(name, snapshot::Kind::Datum, datum); }
+    template<class T> bool load(std::string_view name, Dense_Datum<T>& datum) const { return load_values<T>(name, snapshot::Kind::Dense_Datum, datum); }
+
+    // Replaces the datum's pools and membership with the saved ones. Reference counts and
+    // free pool IDs are rebuilt; pools are no longer interned. A section naming a pool it
+    // does not hold leaves the datum untouched.
+    template<class T> bool load(std::string_view name, Shared_Datum<T>& datum) const {
+        const snapshot::Section* section = match(name, snapshot::Kind::Shared_Datum, sizeof(T));
+        if (!section) return false;
+        std::span<const uint64_t> tokens = column<uint64_t>(section->tokens), pools = column<uint64_t>(section->extra);
+        std::span<const T> values = column<T>(section->values);
+        if (tokens.size() != pools.size()) return false;
+        for (uint64_t pool : pools) if (!pool || pool > values.size()) return false;
+        for (auto& [token, pool] : datum.pools) datum.left(token);
+        datum.pools.clear();
+        datum.data.assign(values.begin(), values.end());
+        datum.refs.assign(values.size(), 0);
+        datum.keys.assign(values.size(), Shared_Datum<T>::npos);
+        datum.free.clear();
+        datum.interned.clear();
+        datum.count = 0;
+        datum.pools.reserve(datum.pools.size() + tokens.size());
+        for (size_t i = 0; i < tokens.size(); ++i) {
+            datum.pools[size_t(tokens[i])] = size_t(pools[i]);
+            ++datum.refs[size_t(pools[i]) - 1];
+            datum.joined(size_t(tokens[i]));
+        }
+        for (size_t pool = values.size(); pool > 0; --pool) if (!datum.refs[pool - 1]) datum.free.push_back(pool);
+        return true;
+    }
+
+    template<class T> bool load(std::string_view name, Static_Datum<T>& datum) const {
+        const snapshot::Section* section = match(name, snapshot::Kind::Static_Datum, sizeof(T));
+        if (!section) return false;
+        std::span<const T> values = column<T>(section->values);
+        if (values.size() != 1) return false;
+        datum.data = values[0];
+        datum.insert(ids(column<uint64_t>(section->tokens)));
+        return true;
+    }
+
+    template<class R, class Fn, class... Args> bool load(std::string_view name, Behavior<R(Args...), Fn>& behavior) const {
+        const snapshot::Section* section = match(name, snapshot::Kind::Subscriptions, 0);
+        if (!section) return false;
+        behavior.insert(ids(column<uint64_t>(section->tokens)));
+        return true;
+    }
+
+    // Restores the registry. Call it before any token is created.
+    bool load(Token_Registry& registry) const {
+        const snapshot::Section* section = match("registry", snapshot::Kind::Registry, sizeof(uint32_t));
+        if (!section) return false;
+        std::vector<size_t> free = ids(column<uint64_t>(section->extra));
+        registry.restore(column<uint32_t>(section->values), free);
+        return true;
+    }
+
+private:
+    const snapshot::Section* match(std::string_view name, snapshot::Kind kind, size_t value_size) const {
+        const snapshot::Section* section = find(name);
+        return section && section->kind == kind && section->value_size == value_size ? section : nullptr;
+    }
+
+    // Returns a column in place, or an empty span if it does not fit inside the file.
+    template<class T> std::span<const T> column(const snapshot::Column& c) const {
+        if (!c.bytes || c.offset > size || c.bytes > size - c.offset || c.offset % alignof(T) || c.bytes % sizeof(T)) return {};
+        return std::span<const T>(reinterpret_cast<const T*>(base + c.offset), size_t(c.bytes / sizeof(T)));
+    }
+
+    // Token IDs as size_t. A copy, since the file stores them as 64-bit integers on every target.
+    static std::vector<size_t> ids(std::span<const uint64_t> tokens) { return std::vector<size_t>(tokens.begin(), tokens.end()); }
+
+    template<class T, class D> bool load_values(std::string_view name, snapshot::Kind kind, D& datum) const {
+        const snapshot::Section* section = match(name, kind, sizeof(T));
+        if (!section) return false;
+        std::span<const uint64_t> tokens = column<uint64_t>(section->tokens);
+        std::span<const T> values = column<T>(section->values);
+        if (tokens.size() != values.size()) return false;
+        datum.assign(ids(tokens), values);
+        return true;
+    }
+
+    const std::byte* base = nullptr;
+    size_t size = 0;
+    std::span<const snapshot::Section> sections;
+    bool valid = false;
+};
+#pragma endregion
@@ -1,189 +1,2841 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
 #include <functional>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <type_traits>
 #include <unordered_map>
 #include <unordered_set>
+#include <utility>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
 /*
 ================================================================================
 Nominal Token Design Pattern - Core Header
 ================================================================================
 
-This header implements the Nominal Token Design Pattern, which separates identity
-(Tokens), data (Datums), and behavior (Behaviors) into distinct, composable units.
+This header implements the Nominal Token Design Pattern, which separates identity
+(Tokens), data (Datums), and behavior (Behaviors) into distinct, composable units.
+
+-------------------------------
+Ideology & Motivation
+-------------------------------
+- **Token**: A nominal type representing a pure identity, containing no data or behavior by default.
+- **Datum**: A data container that holds values but has no identity or behavior of its own.
+- **Behavior**: An executable unit of logic that has no identity or data storage.
+
+This separation of concerns allows for a highly flexible and dynamic system where:
+- Data and behaviors can be associated with tokens at runtime.
+- Objects can be composed with desired characteristics without relying on traditional inheritance, avoiding rigid class hierarchies.
+- Data and behaviors can be shared and reused across multiple tokens or groups of tokens.
+
+-------------------------------
+Usage Overview
+-------------------------------
+The pattern is designed to be intuitive and expressive.
+
+1.  **Create a Token**:
+    `Token myToken;`
+
+2.  **Define a Datum** to hold a specific type of data:
+    `Datum<std::string> Name;`
+    `Dense_Datum<float> Health;` // Same syntax, values packed contiguously for fast iteration.
+    `Buffered_Datum<Vec3> Position;` // Readers on other threads see `Position.read()`, the last `Position.publish()`.
+    `Soa_Datum<Vec3, &Vec3::x, &Vec3::y, &Vec3::z> Position;` // One aligned array per field, for vector kernels.
+
+3.  **Associate Data with a Token**:
+    `myToken + Name = "John Doe";`
+
+4.  **Define a Behavior** to encapsulate logic:
+    `Behavior<void()> Greet = { [&](){ std::cout << "Hello, " << Greet[Name] << std::endl; } };`
+
+5.  **Subscribe a Token to a Behavior**:
+    `myToken += Greet;`
+
+6.  **Execute a Behavior**:
+    `myToken[Greet]();` // Executes for one token
+    `Greet();`          // Executes for all subscribed tokens
+    `Greet.parallel(pool);` // Executes for all subscribed tokens across a Thread_Pool
+    `Greet.watch(Name);`    // Then `Greet.react();` executes only for tokens whose Name changed
+    `Greet.sleep(myToken);` // Skipped by broadcasts until `Greet.wake(myToken);`, at no cost per broadcast
+
+7.  **Destroy a Token**:
+    `myToken.destroy();` // Or let it go out of scope; removes it from every Datum and Behavior
+    `commands.destroy(myToken);` // From inside a broadcast: deferred until `commands.flush();`
+
+8.  **Copy and inspect a Token**:
+    `Token copy = myToken.clone();`     // Same values and subscriptions
+    `Token::clone(prefab, spawned);`    // One prefab onto many tokens at once
+    `std::puts(myToken.describe().c_str());` // Lists containers named with `Name.named("name");`
+
+================================================================================
+*/
+
+#pragma region Declarations
+// Forward declarations for all core components of the pattern.
+struct Token;
+struct Token_Registry;
+struct Container_Registry;
+template<class D> struct Registered;
+struct Token_Set;
+struct Change_Log;
+struct Frame_Arena;
+struct Pool_Resource;
+struct Thread_Pool;
+struct Access;
+template<class t> struct Datum;
+template<class t> struct Dense_Datum;
+template<class t> struct Paged_Datum;
+template<class t> struct Static_Datum;
+template<class t> struct Solitary_Datum;
+template<class t> struct Shared_Datum;
+template<class t> struct Concurrent_Datum;
+template<class t, size_t N = 2> struct Buffered_Datum;
+template<class T, class A, size_t I> struct Archetype_Column;
+template<class... Ts> struct Archetype;
+template<class T, auto... Fields> struct Soa_Datum;
+template<class Signature, class Fn = std::function<Signature>> struct Behavior;
+template<class R, class... Args> struct Batch_Behavior;
+struct Command_Buffer;
+template<class D> struct Query_Traits;
+template<class... Ds> struct Query;
+#pragma endregion
+
+#pragma region Profiling
+// -----------------------------------------------------------------------------
+// Profiling: Opt-in counters for datums and behaviors, switched on at compile time
+// by defining NOMINAL_PROFILE to 1 before including this header.
+// When it is off, the counters are empty and every hook is an empty inline
+// function, so the hot paths compile to exactly what they were without them.
+// When it is on, datums count hits, misses and inserts; behaviors count calls and
+// tokens and keep a latency histogram for the p99. `Container_Registry::profile`
+// reads every counter at once, and `Trace` can record behavior runs as a
+// Chrome trace (chrome://tracing, Perfetto, or Tracy's importer).
+// -----------------------------------------------------------------------------
+#ifndef NOMINAL_PROFILE
+#define NOMINAL_PROFILE 0
+#endif
+constexpr bool profiling = NOMINAL_PROFILE != 0;
+
+// One container's counters, as read by `Container_Registry::profile`.
+struct Profile_Row {
+    const void* container = nullptr;
+    const char* name = nullptr;
+    bool behavior = false;
+    uint64_t calls = 0;       // Behaviors: broadcasts, reactions and single-token calls.
+    uint64_t tokens = 0;      // Behaviors: tokens processed by those calls.
+    uint64_t total_ns = 0;    // Behaviors: time spent in those calls.
+    uint64_t p99_ns = 0;      // Behaviors: 99th percentile call time, within 25%.
+    uint64_t hits = 0;        // Datums: accesses that found a value.
+    uint64_t misses = 0;      // Datums: accesses that found nothing.
+    uint64_t inserts = 0;     // Datums: accesses that created a value.
+    size_t size = 0;          // Entries or subscribed tokens.
+    double load_factor = 0.0; // Hash-based datums only.
+};
+
+// Records behavior runs as trace events while `enabled` is set.
+struct Trace {
+    struct Event { const char* name; uint64_t start_ns; uint64_t duration_ns; size_t thread; };
+
+    // Never destroyed, like the Container_Registry.
+    static Trace& global() { static Trace* trace = new Trace; return *trace; }
+
+    // Nanoseconds on a steady clock.
+    static uint64_t now() {
+        return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+    // A small per-thread number for the trace's thread rows.
+    static size_t thread() { static std::atomic<size_t> next = 0; static thread_local size_t id = next++; return id; }
+
+    void record(const char* name, uint64_t start_ns, uint64_t duration_ns) {
+        if (!enabled.load(std::memory_order_relaxed)) return;
+        std::lock_guard lock(mutex);
+        events.push_back({ name, start_ns, duration_ns, thread() });
+    }
+
+    // Writes the recorded events in the Chrome trace event format. Returns false on a write error.
+    bool write_chrome(std::FILE* file) {
+        std::lock_guard lock(mutex);
+        bool ok = std::fputs("{\"traceEvents\":[\n", file) >= 0;
+        for (size_t i = 0; i < events.size(); ++i) {
+            const Event& e = events[i];
+            ok = ok && std::fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%zu,\"ts\":%.3f,\"dur\":%.3f}\n",
+                i ? "," : "", e.name, e.thread, double(e.start_ns) / 1000.0, double(e.duration_ns) / 1000.0) >= 0;
+        }
+        return ok && std::fputs("]}\n", file) >= 0;
+    }
+    void clear() { std::lock_guard lock(mutex); events.clear(); }
+
+    std::atomic<bool> enabled = false;
+    std::vector<Event> events;
+    std::mutex mutex;
+};
+
+// Datum counters. The disabled form is empty and does nothing.
+template<bool Enabled> struct Datum_Counters {
+    const char* name = nullptr;
+    void hit() {}
+    void miss() {}
+    void insert() {}
+    void read(Profile_Row&) const {}
+};
+template<> struct Datum_Counters<true> {
+    const char* name = "datum";
+    std::atomic<uint64_t> hits = 0, misses = 0, inserts = 0;
+
+    Datum_Counters() = default;
+    Datum_Counters(const Datum_Counters& other) : name(other.name) {}
+    Datum_Counters& operator = (const Datum_Counters&) { return *this; }
+
+    void hit() { hits.fetch_add(1, std::memory_order_relaxed); }
+    void miss() { misses.fetch_add(1, std::memory_order_relaxed); }
+    void insert() { inserts.fetch_add(1, std::memory_order_relaxed); }
+    void read(Profile_Row& row) const {
+        row.name = name;
+        row.hits = hits.load(std::memory_order_relaxed);
+        row.misses = misses.load(std::memory_order_relaxed);
+        row.inserts = inserts.load(std::memory_order_relaxed);
+    }
+};
+using Datum_Stats = Datum_Counters<profiling>;
+
+// Behavior counters. `scope(count)` times a call over `count` tokens until it goes out of scope.
+template<bool Enabled> struct Behavior_Counters {
+    struct Scope {};
+    const char* name = nullptr;
+    Scope scope(size_t) { return {}; }
+    void read(Profile_Row&) const {}
+};
+template<> struct Behavior_Counters<true> {
+    static constexpr size_t buckets = 256; // Four per power of two, so each bucket spans at most 25%.
+
+    struct Scope {
+        Behavior_Counters* stats;
+        uint64_t start;
+        size_t count;
+        ~Scope() { stats->record(start, Trace::now() - start, count); }
+    };
+
+    const char* name = "behavior";
+    std::atomic<uint64_t> calls = 0, tokens = 0, total = 0;
+    std::unique_ptr<std::atomic<uint64_t>[]> histogram = std::make_unique<std::atomic<uint64_t>[]>(buckets);
+
+    Behavior_Counters() = default;
+    Behavior_Counters(const Behavior_Counters& other) : name(other.name) {}
+    Behavior_Counters& operator = (const Behavior_Counters&) { return *this; }
+
+    Scope scope(size_t count) { return { this, Trace::now(), count }; }
+
+    void record(uint64_t start, uint64_t ns, size_t count) {
+        calls.fetch_add(1, std::memory_order_relaxed);
+        tokens.fetch_add(count, std::memory_order_relaxed);
+        total.fetch_add(ns, std::memory_order_relaxed);
+        histogram[bucket(ns)].fetch_add(1, std::memory_order_relaxed);
+        Trace::global().record(name, start, ns);
+    }
+
+    // The upper bound of the bucket holding the 99th percentile call.
+    uint64_t p99() const {
+        uint64_t count = calls.load(std::memory_order_relaxed), seen = 0;
+        uint64_t target = count - count / 100;
+        for (size_t i = 0; i < buckets; ++i) {
+            seen += histogram[i].load(std::memory_order_relaxed);
+            if (count && seen >= target) return upper(i);
+        }
+        return 0;
+    }
+
+    void read(Profile_Row& row) const {
+        row.name = name;
+        row.behavior = true;
+        row.calls = calls.load(std::memory_order_relaxed);
+        row.tokens = tokens.load(std::memory_order_relaxed);
+        row.total_ns = total.load(std::memory_order_relaxed);
+        row.p99_ns = p99();
+    }
+
+    static size_t bucket(uint64_t ns) {
+        if (ns < 4) return size_t(ns);
+        size_t b = size_t(std::bit_width(ns)) - 1;
+        return b * 4 + size_t((ns >> (b - 2)) & 3);
+    }
+    static uint64_t upper(size_t i) {
+        if (i < 4) return i;
+        size_t b = i / 4;
+        return ((uint64_t(4 + i % 4 + 1)) << (b - 2)) - 1;
+    }
+};
+using Behavior_Stats = Behavior_Counters<profiling>;
+#pragma endregion
+
+#pragma region Identity
+// -----------------------------------------------------------------------------
+// Token_Registry: Hands out token IDs and recycles them once tokens are destroyed.
+// An ID packs a slot index (low bits) and a generation (high bits). Destroying a
+// token bumps its slot's generation, so stale copies of the ID are detected in O(1)
+// by `alive`, while the slot itself is reused and IDs stay compact for dense storage.
+// Fresh slots are claimed with an atomic counter; recycled slots come from a locked free list.
+// -----------------------------------------------------------------------------
+struct Token_Registry {
+    static constexpr size_t index_bits = sizeof(size_t) == 8 ? 32 : 20;
+    static constexpr size_t index_mask = (size_t(1) << index_bits) - 1;
+    static constexpr size_t generation_mask = ~size_t(0) >> index_bits;
+    static constexpr size_t page_bits = 16;
+    static constexpr size_t page_size = size_t(1) << page_bits;
+    static constexpr size_t page_count = size_t(1) << (index_bits - page_bits);
+
+    // Splits a token ID into its slot index and generation.
+    static size_t index_of(size_t token) { return token & index_mask; }
+    static size_t generation_of(size_t token) { return token >> index_bits; }
+
+    // The registry used by default-constructed Tokens.
+    static Token_Registry& global() { static Token_Registry registry; return registry; }
+
+    Token_Registry() : pages(std::make_unique<std::atomic<std::atomic<uint32_t>*>[]>(page_count)) {}
+    ~Token_Registry() { for (size_t i = 0; i < page_count; ++i) delete[] pages[i].load(); }
+    Token_Registry(const Token_Registry&) = delete;
+    Token_Registry& operator = (const Token_Registry&) = delete;
+
+    // Returns a new live token ID. Slot 0 is never used, so 0 stays the invalid ID.
+    size_t create() {
+        if (recycled.load(std::memory_order_relaxed)) {
+            std::lock_guard lock(mutex);
+            if (!free.empty()) {
+                size_t index = free.back();
+                free.pop_back();
+                recycled.fetch_sub(1, std::memory_order_relaxed);
+                return index | (size_t(generation(index).load(std::memory_order_relaxed)) << index_bits);
+            }
+        }
+        size_t index = next.fetch_add(1, std::memory_order_relaxed);
+        assert(index <= index_mask && "Token_Registry ran out of token slots.");
+        generation(index); // Make sure the slot's page exists before the ID is handed out.
+        return index;
+    }
+
+    // Retires a token ID and queues its slot for reuse. Stale IDs are ignored.
+    void destroy(size_t token) {
+        if (!alive(token)) return;
+        size_t index = index_of(token);
+        generation(index).store(uint32_t((generation_of(token) + 1) & generation_mask), std::memory_order_release);
+        std::lock_guard lock(mutex);
+        free.push_back(index);
+        recycled.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // True if the ID belongs to a token that has not been destroyed. Lock-free.
+    bool alive(size_t token) const {
+        size_t index = index_of(token);
+        if (!index || index >= next.load(std::memory_order_acquire)) return false;
+        std::atomic<uint32_t>* page = pages[index >> page_bits].load(std::memory_order_acquire);
+        return page && page[index & (page_size - 1)].load(std::memory_order_acquire) == generation_of(token);
+    }
+
+    // One past the highest slot index handed out so far; the extent dense storage needs.
+    size_t capacity() const { return next.load(std::memory_order_relaxed); }
+
+    // The current generation of a slot. Together with `free_slots` this is the registry's whole state.
+    uint32_t generation_at(size_t index) const {
+        std::atomic<uint32_t>* page = pages[index >> page_bits].load(std::memory_order_acquire);
+        return page ? page[index & (page_size - 1)].load(std::memory_order_acquire) : 0;
+    }
+    // A copy of the slots waiting to be reused.
+    std::vector<size_t> free_slots() {
+        std::lock_guard lock(mutex);
+        return free;
+    }
+
+    // Replaces the registry's state with a saved one (see Snapshot), so restored token IDs
+    // stay alive and new ones do not collide with them. Only call it before any token is created.
+    void restore(std::span<const uint32_t> generations, std::span<const size_t> free_list) {
+        std::lock_guard lock(mutex);
+        for (size_t i = 1; i < generations.size(); ++i) generation(i).store(generations[i], std::memory_order_relaxed);
+        free.assign(free_list.begin(), free_list.end());
+        recycled.store(free.size(), std::memory_order_relaxed);
+        next.store(std::max<size_t>(1, generations.size()), std::memory_order_release);
+    }
+
+private:
+    // Returns a slot's generation counter, allocating its page on first use.
+    std::atomic<uint32_t>& generation(size_t index) {
+        std::atomic<std::atomic<uint32_t>*>& slot = pages[index >> page_bits];
+        std::atomic<uint32_t>* page = slot.load(std::memory_order_acquire);
+        if (!page) {
+            std::atomic<uint32_t>* fresh = new std::atomic<uint32_t>[page_size]();
+            if (slot.compare_exchange_strong(page, fresh, std::memory_order_acq_rel)) page = fresh;
+            else delete[] fresh;
+        }
+        return page[index & (page_size - 1)];
+    }
+
+    std::unique_ptr<std::atomic<std::atomic<uint32_t>*>[]> pages; // Generation counters, in fixed pages that never move.
+    std::atomic<size_t> next = 1;                                 // The next never-used slot.
+    std::atomic<size_t> recycled = 0;                             // The size of `free`, readable without the lock.
+    std::vector<size_t> free;                                     // Slots of destroyed tokens.
+    std::mutex mutex;
+};
+
+// -----------------------------------------------------------------------------
+// Container_Registry: Knows every live Datum and Behavior, so a token can be
+// removed from, copied between or inspected across all of them at once.
+// Each entry erases a whole batch of tokens in one call, so destroying N tokens
+// costs one pass per container instead of N separate lookups into every container.
+// Containers whose insert paths report new members also get a membership bit, set
+// in a per-token mask kept here, so `erase`, `clone` and `describe` skip containers
+// a token was never in without probing them. The mask may hold stale bits, which only
+// cost a `contains` check; containers without a bit (past the first
+// NOMINAL_MEMBERSHIP_WORDS * 64, or copies) are always probed. Membership
+// written straight into a container's public members is not seen by the mask.
+// -----------------------------------------------------------------------------
+#ifndef NOMINAL_MEMBERSHIP_WORDS
+#define NOMINAL_MEMBERSHIP_WORDS 1
+#endif
+
+struct Container_Registry {
+    static constexpr size_t words = NOMINAL_MEMBERSHIP_WORDS; // 64-bit mask words per token.
+    static constexpr size_t no_bit = ~size_t(0);
+
+    struct Entry {
+        void* container;
+        void (*erase)(void* container, std::span<const size_t> tokens);
+        void (*profile)(const void* container, Profile_Row& row);                 // Null unless NOMINAL_PROFILE is on.
+        bool (*contains)(const void* container, size_t token);
+        void (*clone)(void* container, size_t from, std::span<const size_t> to);  // Null if the container cannot copy a token.
+        void (*describe)(const void* container, size_t token, std::string& out);
+        size_t bit = no_bit;        // The container's membership bit, or no_bit if it is always probed.
+        const char* name = nullptr; // Set with `Registered::named`.
+    };
+
+    // Never destroyed, so tokens that outlive every container at exit can still unregister.
+    static Container_Registry& global() { static Container_Registry* registry = new Container_Registry; return *registry; }
+
+    Container_Registry() : pages(std::make_unique<std::atomic<std::atomic<uint64_t>*>[]>(Token_Registry::page_count)) {}
+    Container_Registry(const Container_Registry&) = delete;
+    Container_Registry& operator = (const Container_Registry&) = delete;
+
+    // Registers a container and returns its membership bit, or no_bit if `tracks` is false or none are left.
+    size_t add(Entry entry, bool tracks) {
+        std::lock_guard lock(mutex);
+        if (tracks && !free_bits.empty()) { entry.bit = free_bits.back(); free_bits.pop_back(); }
+        else if (tracks && next_bit < words * 64) entry.bit = next_bit++;
+        entries.push_back(entry);
+        return entry.bit;
+    }
+    void remove(void* container) {
+        std::lock_guard lock(mutex);
+        auto it = std::find_if(entries.begin(), entries.end(), [&](const Entry& e) { return e.container == container; });
+        if (it == entries.end()) return;
+        if (it->bit != no_bit) free_bits.push_back(it->bit); // Tokens may keep the bit; the next owner just probes them.
+        *it = entries.back();
+        entries.pop_back();
+    }
+    // Names a container for `describe` and the profiler.
+    void name(const void* container, const char* iname) {
+        std::lock_guard lock(mutex);
+        for (Entry& e : entries) if (e.container == container) e.name = iname;
+    }
+
+    // Marks a token as a member of the container owning `bit`. Lock-free, so parallel behaviors may insert.
+    void join(size_t bit, size_t token) {
+        word(Token_Registry::index_of(token), bit >> 6).fetch_or(uint64_t(1) << (bit & 63), std::memory_order_relaxed);
+    }
+    void leave(size_t bit, size_t token) {
+        if (std::atomic<uint64_t>* w = find_word(Token_Registry::index_of(token), bit >> 6)) w->fetch_and(~(uint64_t(1) << (bit & 63)), std::memory_order_relaxed);
+    }
+
+    // Removes the tokens from every container they may be in, and clears their masks.
+    void erase(std::span<const size_t> tokens) {
+        if (tokens.empty()) return;
+        std::lock_guard lock(mutex);
+        std::vector<size_t> members;
+        for (const Entry& e : entries) {
+            if (e.bit == no_bit) { e.erase(e.container, tokens); continue; }
+            members.clear();
+            for (size_t token : tokens) if (marked(token, e.bit)) members.push_back(token);
+            if (!members.empty()) e.erase(e.container, members);
+        }
+        for (size_t token : tokens) {
+            size_t slot = Token_Registry::index_of(token);
+            for (size_t w = 0; w < words; ++w) if (std::atomic<uint64_t>* m = find_word(slot, w)) m->store(0, std::memory_order_relaxed);
+        }
+    }
+
+    // Calls `f(entry)` for every container the token is in.
+    template<class F> void members(size_t token, F&& f) {
+        std::lock_guard lock(mutex);
+        for (const Entry& e : entries) {
+            if (e.bit != no_bit && !marked(token, e.bit)) continue;
+            if (e.contains(e.container, token)) f(e);
+        }
+    }
+
+    // Gives every `to` token the values and subscriptions `from` has, one bulk call per
+    // container `from` is in. Returns the number of containers copied.
+    size_t clone(size_t from, std::span<const size_t> to) {
+        size_t copied = 0;
+        members(from, [&](const Entry& e) { if (e.clone) { e.clone(e.container, from, to); ++copied; } });
+        return copied;
+    }
+
+    // Lists every container the token is in, one "name: value" line each.
+    std::string describe(size_t token) {
+        std::string text;
+        members(token, [&](const Entry& e) {
+            text += e.name ? e.name : "unnamed";
+            text += ": ";
+            e.describe(e.container, token, text);
+            text += "\n";
+        });
+        return text;
+    }
+
+    // Reads the counters of every container. Empty unless NOMINAL_PROFILE is on.
+    std::vector<Profile_Row> profile() {
+        std::vector<Profile_Row> rows;
+        std::lock_guard lock(mutex);
+        for (const Entry& e : entries) {
+            if (!e.profile) continue;
+            rows.emplace_back().container = e.container;
+            e.profile(e.container, rows.back());
+            if (e.name) rows.back().name = e.name;
+        }
+        return rows;
+    }
+
+    std::vector<Entry> entries;
+    std::mutex mutex;
+
+private:
+    bool marked(size_t token, size_t bit) const {
+        const std::atomic<uint64_t>* w = find_word(Token_Registry::index_of(token), bit >> 6);
+        return w && (w->load(std::memory_order_relaxed) >> (bit & 63)) & 1;
+    }
+
+    // Returns a mask word, allocating its page on first use, or without allocating (null if absent).
+    std::atomic<uint64_t>& word(size_t slot, size_t w) {
+        std::atomic<std::atomic<uint64_t>*>& page_slot = pages[slot >> Token_Registry::page_bits];
+        std::atomic<uint64_t>* page = page_slot.load(std::memory_order_acquire);
+        if (!page) {
+            std::atomic<uint64_t>* fresh = new std::atomic<uint64_t>[Token_Registry::page_size * words]();
+            if (page_slot.compare_exchange_strong(page, fresh, std::memory_order_acq_rel)) page = fresh;
+            else delete[] fresh;
+        }
+        return page[(slot & (Token_Registry::page_size - 1)) * words + w];
+    }
+    std::atomic<uint64_t>* find_word(size_t slot, size_t w) const {
+        std::atomic<uint64_t>* page = pages[slot >> Token_Registry::page_bits].load(std::memory_order_acquire);
+        return page ? &page[(slot & (Token_Registry::page_size - 1)) * words + w] : nullptr;
+    }
+
+    std::unique_ptr<std::atomic<std::atomic<uint64_t>*>[]> pages; // Membership masks by slot, in fixed pages that never move.
+    std::vector<size_t> free_bits;                                // Bits released by destroyed containers.
+    size_t next_bit = 0;                                          // The next never-used bit.
+};
+
+// -----------------------------------------------------------------------------
+// Registered: Base of every container, joining it to the Container_Registry for
+// its lifetime. The derived container provides `erase(std::span<const size_t>)`
+// and `contains(token) const`, and optionally `clone(from, to)`. A container that
+// sets `tracks_members` calls `joined` and `left` from every path that adds or
+// removes a token, and gets a membership bit in return.
+// -----------------------------------------------------------------------------
+template<class D>
+struct Registered {
+    Registered() { enroll(true); }
+    // A copy starts with the members of its source, which its new bit never saw, so it is always probed.
+    Registered(const Registered&) { enroll(false); }
+    Registered& operator = (const Registered&) {
+        Container_Registry::global().remove(this);
+        enroll(false);
+        return *this;
+    }
+    ~Registered() { Container_Registry::global().remove(this); }
+
+    // Names the container for `Container_Registry::describe` and the profiler.
+    D& named(const char* name) {
+        Container_Registry::global().name(this, name);
+        return static_cast<D&>(*this);
+    }
+
+    // Reports a token that became or stopped being a member.
+    void joined(size_t token) const { if (bit != Container_Registry::no_bit) Container_Registry::global().join(bit, token); }
+    void left(size_t token) const { if (bit != Container_Registry::no_bit) Container_Registry::global().leave(bit, token); }
+
+    static void erase(void* self, std::span<const size_t> tokens) {
+        static_cast<D*>(static_cast<Registered*>(self))->erase(tokens);
+    }
+    static bool contains(const void* self, size_t token) {
+        return static_cast<const D*>(static_cast<const Registered*>(self))->contains(token);
+    }
+    static void clone(void* self, size_t from, std::span<const size_t> to) {
+        static_cast<D*>(static_cast<Registered*>(self))->clone(from, to);
+    }
+
+    // Appends the token's value, or "member" for containers without values.
+    static void describe(const void* self, size_t token, std::string& out) {
+        D& d = *const_cast<D*>(static_cast<const D*>(static_cast<const Registered*>(self)));
+        if constexpr (requires { d.find(token); }) { if (auto value = d.find(token)) describe_value(*value, out); }
+        else out += "member";
+    }
+
+    // Reads the container's `stats`, plus its size and load factor where it has them.
+    static void profile(const void* self, Profile_Row& row) {
+        const D& d = *static_cast<const D*>(static_cast<const Registered*>(self));
+        if constexpr (requires { d.stats; }) d.stats.read(row);
+        if constexpr (requires { d.size(); }) row.size = d.size();
+        else if constexpr (requires { d.tokens.size(); }) row.size = d.tokens.size();
+        else if constexpr (requires { d.data.size(); }) row.size = d.data.size();
+        if constexpr (requires { d.data.load_factor(); }) row.load_factor = double(d.data.load_factor());
+    }
+
+private:
+    size_t bit = Container_Registry::no_bit;
+
+    void enroll(bool tracks) {
+        Container_Registry::Entry entry{ this, &erase, nullptr, &contains, nullptr, &describe };
+        if constexpr (profiling) entry.profile = &profile;
+        if constexpr (requires(D& d, std::span<const size_t> to) { d.clone(size_t(0), to); }) entry.clone = &clone;
+        if constexpr (requires { D::tracks_members; }) bit = Container_Registry::global().add(entry, tracks && D::tracks_members);
+        else bit = Container_Registry::global().add(entry, false);
+    }
+
+    template<class V> static void describe_value(const V& value, std::string& out) {
+        if constexpr (std::is_same_v<V, bool>) out += value ? "true" : "false";
+        else if constexpr (std::is_arithmetic_v<V>) out += std::to_string(value);
+        else if constexpr (std::is_convertible_v<const V&, std::string_view>) { out += '"'; out += std::string_view(value); out += '"'; }
+        else {
+            char text[32];
+            std::snprintf(text, sizeof(text), "<%zu bytes>", sizeof(V));
+            out += text;
+        }
+    }
+};
+#pragma endregion
+
+#pragma region Memory
+// -----------------------------------------------------------------------------
+// Every container takes an optional std::pmr::memory_resource, so its nodes and
+// arrays can come from an arena or a pool instead of the global heap. The two
+// resources below are unsynchronized: give each thread its own, and clear or
+// destroy the containers using one before resetting or releasing it.
+// -----------------------------------------------------------------------------
+
+// -----------------------------------------------------------------------------
+// Frame_Arena: A bump allocator whose memory is reclaimed all at once by `reset`.
+// Deallocation is a no-op. Blocks are kept across resets, so in a steady state a
+// frame takes nothing from the upstream resource.
+// -----------------------------------------------------------------------------
+struct Frame_Arena : std::pmr::memory_resource {
+    explicit Frame_Arena(size_t iblock_size = size_t(1) << 20, std::pmr::memory_resource* iupstream = std::pmr::get_default_resource())
+        : block_size(iblock_size), upstream(iupstream) {}
+    ~Frame_Arena() { release(); }
+    Frame_Arena(const Frame_Arena&) = delete;
+    Frame_Arena& operator = (const Frame_Arena&) = delete;
+
+    // Invalidates everything allocated so far and starts again at the first block.
+    void reset() { current = 0; offset = 0; }
+
+    // Returns every block to the upstream resource.
+    void release() {
+        for (Block& block : blocks) upstream->deallocate(block.data, block.size, alignof(std::max_align_t));
+        blocks.clear();
+        reset();
+    }
+
+private:
+    struct Block { std::byte* data; size_t size; };
+
+    void* do_allocate(size_t bytes, size_t align) override {
+        for (; current < blocks.size(); ++current, offset = 0) {
+            void* p = blocks[current].data + offset;
+            size_t space = blocks[current].size - offset;
+            if (std::align(align, bytes, p, space)) {
+                offset = size_t(static_cast<std::byte*>(p) - blocks[current].data) + bytes;
+                return p;
+            }
+        }
+        size_t size = std::max(block_size, bytes + align);
+        blocks.push_back({ static_cast<std::byte*>(upstream->allocate(size, alignof(std::max_align_t))), size });
+        return do_allocate(bytes, align);
+    }
+    void do_deallocate(void*, size_t, size_t) override {}
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+    size_t block_size;
+    std::pmr::memory_resource* upstream;
+    std::vector<Block> blocks;
+    size_t current = 0; // The block being bumped.
+    size_t offset = 0;  // The first free byte in it.
+};
+
+// -----------------------------------------------------------------------------
+// Pool_Resource: Hands out fixed-size blocks from a free list, refilled a chunk at a time.
+// Requests larger than the block size, such as hash bucket arrays, go upstream.
+// Size the blocks to the container's node (e.g. a few words for Datum<float>).
+// -----------------------------------------------------------------------------
+struct Pool_Resource : std::pmr::memory_resource {
+    explicit Pool_Resource(size_t iblock_size, size_t iblocks_per_chunk = 1024, std::pmr::memory_resource* iupstream = std::pmr::get_default_resource())
+        : block_size((std::max(iblock_size, sizeof(void*)) + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) * alignof(std::max_align_t)),
+          blocks_per_chunk(iblocks_per_chunk ? iblocks_per_chunk : 1), upstream(iupstream) {}
+    ~Pool_Resource() { release(); }
+    Pool_Resource(const Pool_Resource&) = delete;
+    Pool_Resource& operator = (const Pool_Resource&) = delete;
+
+    // Returns every chunk to the upstream resource, invalidating all blocks at once.
+    void release() {
+        for (std::byte* chunk : chunks) upstream->deallocate(chunk, block_size * blocks_per_chunk, alignof(std::max_align_t));
+        chunks.clear();
+        free = nullptr;
+    }
+
+private:
+    struct Node { Node* next; };
+
+    bool pooled(size_t bytes, size_t align) const { return bytes <= block_size && align <= alignof(std::max_align_t); }
+
+    void* do_allocate(size_t bytes, size_t align) override {
+        if (!pooled(bytes, align)) return upstream->allocate(bytes, align);
+        if (!free) {
+            std::byte* chunk = static_cast<std::byte*>(upstream->allocate(block_size * blocks_per_chunk, alignof(std::max_align_t)));
+            chunks.push_back(chunk);
+            for (size_t i = blocks_per_chunk; i-- > 0;) free = new (chunk + i * block_size) Node{ free };
+        }
+        Node* node = free;
+        free = node->next;
+        return node;
+    }
+    void do_deallocate(void* p, size_t bytes, size_t align) override {
+        if (!pooled(bytes, align)) { upstream->deallocate(p, bytes, align); return; }
+        free = new (p) Node{ free };
+    }
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+    size_t block_size;
+    size_t blocks_per_chunk;
+    std::pmr::memory_resource* upstream;
+    std::vector<std::byte*> chunks;
+    Node* free = nullptr;
+};
+
+// Rebuilds an empty pmr container on another resource. A pmr container keeps the resource
+// it was constructed with, even across assignment, so members that are built before the
+// resource is known, such as the elements of an array, are moved onto it with this.
+template<class C> void rebuild_on(C& container, std::pmr::memory_resource* resource) {
+    assert(container.empty() && "Only an empty container can move to another resource.");
+    std::destroy_at(&container);
+    std::construct_at(&container, resource);
+}
+#pragma endregion
+
+#pragma region Containers
+// -----------------------------------------------------------------------------
+// Token_Set: A sparse set of token IDs.
+// IDs are packed into a dense array so iteration is a linear scan, while a
+// sparse index keyed by slot index gives O(1) lookups, inserts and swap-removes.
+// Lookups compare the full ID, so stale IDs of a reused slot are not members.
+// `sorted` tracks whether `dense` is still in ascending slot order, so callers that
+// want ordered walks only pay for `sort()` after the set has actually changed.
+//
+// `partition(count)` splits the set into contiguous ranges of `dense`, such as awake
+// and sleeping tokens, so a walk over one partition skips the others entirely. New
+// tokens join partition 0, and moving a token between partitions p and q costs
+// |p - q| swaps. Each partition is sorted on its own. Partitioned sets are for
+// containers without arrays parallel to `dense`: erase and move shuffle more than
+// the one position they report.
+// -----------------------------------------------------------------------------
+struct Token_Set {
+    static constexpr size_t npos = ~size_t(0);
+
+    std::pmr::vector<size_t> dense;   // The packed token IDs.
+    std::pmr::vector<size_t> sparse;  // Maps a slot index to its dense position + 1 (0 = absent).
+    bool sorted = true;               // True while `dense` is in ascending slot order (every partition, if partitioned).
+    std::pmr::vector<size_t> bounds;  // With partitions: the end in `dense` of every partition but the last.
+    std::pmr::vector<uint8_t> ordered; // With partitions: 1 while that partition is in ascending slot order.
+
+    Token_Set(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) : dense(resource), sparse(resource), bounds(resource), ordered(resource) {}
+
+    static size_t slot(size_t token) { return Token_Registry::index_of(token); }
+
+    // Returns the dense position of a token, or npos if it is not in the set.
+    size_t index(size_t token) const {
+        size_t s = slot(token);
+        if (s >= sparse.size() || !sparse[s]) return npos;
+        size_t i = sparse[s] - 1;
+        return dense[i] == token ? i : npos;
+    }
+    bool contains(size_t token) const { return index(token) != npos; }
+
+    // Adds a token if it is not already present and returns its dense position.
+    // A stale ID of the same slot is replaced in place rather than appended.
+    size_t insert(size_t token) {
+        size_t s = slot(token);
+        if (s >= sparse.size()) sparse.resize(s + 1, 0);
+        if (sparse[s]) {
+            dense[sparse[s] - 1] = token;
+            return sparse[s] - 1;
+        }
+        if (!bounds.empty()) return join_first(token);
+        if (!dense.empty() && s < slot(dense.back())) sorted = false;
+        dense.push_back(token);
+        sparse[s] = dense.size();
+        return dense.size() - 1;
+    }
+
+    // Adds several tokens at once. Capacity and the sparse index grow in one step,
+    // and tokens given in ascending order keep a sorted set sorted. Invalid (0) IDs are skipped.
+    void insert(std::span<const size_t> tokens) {
+        size_t top = 0;
+        for (size_t token : tokens) top = std::max(top, slot(token));
+        if (top >= sparse.size()) sparse.resize(top + 1, 0);
+        dense.reserve(dense.size() + tokens.size());
+        for (size_t token : tokens) if (token) insert(token);
+    }
+
+    // Reserves room for `n` tokens in total, and for slots below `n` in the sparse index.
+    void reserve(size_t n) { dense.reserve(n); sparse.reserve(n); }
+
+    // Swap-removes a token and returns the dense position it vacated, or npos if absent.
+    // The previously last token now occupies that position.
+    size_t erase(size_t token) {
+        size_t i = index(token);
+        if (i == npos) return npos;
+        if (!bounds.empty()) {
+            move(token, partitions() - 1);
+            i = sparse[slot(token)] - 1;
+            if (i != dense.size() - 1) { exchange(i, dense.size() - 1); unsorted(partitions() - 1); }
+            sparse[slot(token)] = 0;
+            dense.pop_back();
+            return i;
+        }
+        size_t last = dense.back();
+        dense[i] = last;
+        sparse[slot(last)] = i + 1;
+        sparse[slot(token)] = 0;
+        dense.pop_back();
+        if (i != dense.size()) sorted = false;
+        return i;
+    }
+
+    // Swaps the tokens at two dense positions.
+    void swap_positions(size_t a, size_t b) {
+        if (a == b) return;
+        std::swap(dense[a], dense[b]);
+        sparse[slot(dense[a])] = a + 1;
+        sparse[slot(dense[b])] = b + 1;
+        sorted = false;
+    }
+
+    // Restores ascending slot order. Containers holding arrays parallel to `dense`
+    // must permute them too (see Dense_Datum::sort).
+    void sort() {
+        if (sorted) return;
+        if (bounds.empty()) {
+            std::sort(dense.begin(), dense.end(), [](size_t a, size_t b) { return slot(a) < slot(b); });
+            for (size_t i = 0; i < dense.size(); ++i) sparse[slot(dense[i])] = i + 1;
+        }
+        else for (size_t p = 0; p < partitions(); ++p) sort(p);
+        sorted = true;
+    }
+    // Restores ascending slot order within one partition only.
+    void sort(size_t p) {
+        if (bounds.empty()) { sort(); return; }
+        if (ordered[p]) return;
+        size_t begin = first(p), end = last(p);
+        std::sort(dense.begin() + begin, dense.begin() + end, [](size_t a, size_t b) { return slot(a) < slot(b); });
+        for (size_t i = begin; i < end; ++i) sparse[slot(dense[i])] = i + 1;
+        ordered[p] = 1;
+        sorted = std::find(ordered.begin(), ordered.end(), uint8_t(0)) == ordered.end();
+    }
+
+    // Splits the set into `count` partitions, with every token in partition 0.
+    // A count of 0 or 1 removes the partitions.
+    void partition(size_t count) {
+        bool was = !bounds.empty();
+        if (count <= 1) {
+            bounds.clear();
+            ordered.clear();
+            if (was) sorted = false;
+            return;
+        }
+        bounds.assign(count - 1, dense.size());
+        ordered.assign(count, 1);
+        ordered[0] = !was && sorted;
+        sorted = ordered[0];
+    }
+    size_t partitions() const { return bounds.size() + 1; }
+    // The partition holding the token at a dense position.
+    size_t partition_at(size_t i) const {
+        size_t p = 0;
+        while (p < bounds.size() && i >= bounds[p]) ++p;
+        return p;
+    }
+    // The partition holding a token, or npos if it is not in the set.
+    size_t partition_of(size_t token) const {
+        size_t i = index(token);
+        return i == npos ? npos : partition_at(i);
+    }
+    // The tokens of one partition, in dense order.
+    std::span<const size_t> members(size_t p) const { return std::span<const size_t>(dense).subspan(first(p), last(p) - first(p)); }
+
+    // Moves a token to another partition, one boundary swap per partition crossed.
+    // Returns false if the token is not in the set.
+    bool move(size_t token, size_t to) {
+        size_t i = index(token);
+        if (i == npos) return false;
+        if (bounds.empty()) return true;
+        size_t from = partition_at(i);
+        for (; from < to; ++from) {
+            size_t end = bounds[from] - 1;
+            if (i != end) { exchange(i, end); unsorted(from); }
+            i = end;
+            --bounds[from];
+        }
+        for (; from > to; --from) {
+            size_t begin = bounds[from - 1];
+            if (i != begin) { exchange(i, begin); unsorted(from); }
+            i = begin;
+            ++bounds[from - 1];
+        }
+        size_t s = slot(token);
+        if ((i > first(to) && slot(dense[i - 1]) > s) || (i + 1 < last(to) && slot(dense[i + 1]) < s)) unsorted(to);
+        return true;
+    }
+
+    size_t size() const { return dense.size(); }
+    bool empty() const { return dense.empty(); }
+    void clear() {
+        for (size_t token : dense) sparse[slot(token)] = 0;
+        dense.clear();
+        sorted = true;
+        std::fill(bounds.begin(), bounds.end(), size_t(0));
+        std::fill(ordered.begin(), ordered.end(), uint8_t(1));
+    }
+
+    std::pmr::vector<size_t>::const_iterator begin() const { return dense.begin(); }
+    std::pmr::vector<size_t>::const_iterator end() const { return dense.end(); }
+
+private:
+    size_t first(size_t p) const { return p ? bounds[p - 1] : 0; }
+    size_t last(size_t p) const { return p < bounds.size() ? bounds[p] : dense.size(); }
+
+    void exchange(size_t a, size_t b) {
+        std::swap(dense[a], dense[b]);
+        sparse[slot(dense[a])] = a + 1;
+        sparse[slot(dense[b])] = b + 1;
+    }
+    void unsorted(size_t p) { ordered[p] = 0; sorted = false; }
+
+    // Appends a new token to a partitioned set and moves it down into partition 0.
+    size_t join_first(size_t token) {
+        size_t i = dense.size();
+        dense.push_back(token);
+        sparse[slot(token)] = i + 1;
+        for (size_t p = bounds.size(); p-- > 0;) {
+            size_t begin = bounds[p];
+            if (i != begin) { exchange(i, begin); unsorted(p + 1); }
+            i = begin;
+            ++bounds[p];
+        }
+        if (i && slot(dense[i - 1]) > slot(token)) unsorted(0);
+        return i;
+    }
+};
+
+// -----------------------------------------------------------------------------
+// Change_Log: Records which IDs were added, changed or removed, for datums with
+// change tracking turned on (see Datum::track).
+// Every change gets the next version number. Only the latest change of an ID is
+// kept, so `since(version)` visits each ID changed after that version once, in
+// change order, and costs O(changes) rather than O(tokens). Consumers remember
+// `version` after a pass and ask for what happened since; `trim` drops history
+// nobody needs any more. Consumers that `follow` the log hold a cursor instead, and
+// `advance` trims whatever every live cursor has handled, so a tracked datum under
+// spawn-and-destroy churn keeps only the history its slowest reader still needs.
+// Recording takes a lock, so parallel behaviors may write tracked datums.
+// -----------------------------------------------------------------------------
+struct Change_Log {
+    enum class Kind : uint8_t { Added, Changed, Removed };
+    struct Change { size_t version; size_t id; Kind kind; }; // A superseded change has id 0.
+    using Cursor = std::shared_ptr<size_t>;                  // A reader's last handled version.
+
+    std::pmr::vector<Change> entries;               // In ascending version order.
+    std::pmr::unordered_map<size_t, size_t> latest; // Maps an ID to the version of its live entry.
+    std::atomic<size_t> version = 0;                // The version of the most recent change; readable without the lock.
+    size_t superseded = 0;                          // Entries whose ID changed again later.
+    bool enabled = false;
+
+    Change_Log(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) : entries(resource), latest(resource) {}
+    // Copies carry the history but not the cursors; readers keep following the original.
+    Change_Log(const Change_Log& other)
+        : entries(other.entries), latest(other.latest), version(other.version.load()), superseded(other.superseded), enabled(other.enabled) {}
+    Change_Log& operator = (const Change_Log& other) {
+        if (this == &other) return *this;
+        std::lock_guard lock(mutex);
+        entries = other.entries;
+        latest = other.latest;
+        version = other.version.load();
+        superseded = other.superseded;
+        enabled = other.enabled;
+        cursors.clear();
+        return *this;
+    }
+
+    // Records a change of `id` if tracking is on. Added and Changed both mean the ID now has a value.
+    void record(size_t id, Kind kind) {
+        if (!enabled || !id) return;
+        std::lock_guard lock(mutex);
+        size_t now = version.load(std::memory_order_relaxed) + 1;
+        auto [it, fresh] = latest.try_emplace(id, now);
+        if (!fresh) {
+            entry(it->second).id = 0;
+            ++superseded;
+            it->second = now;
+        }
+        entries.push_back({ now, id, kind });
+        version.store(now, std::memory_order_release);
+        if (superseded > 64 && superseded * 2 > entries.size()) compact();
+    }
+
+    // Calls `f(id, kind)` for every ID whose latest change came after `since_version`.
+    template<class F> void since(size_t since_version, F&& f) const {
+        for (auto it = first_after(since_version); it != entries.end(); ++it) if (it->id) f(it->id, it->kind);
+    }
+
+    // Forgets every change up to and including `through_version`.
+    void trim(size_t through_version) {
+        std::lock_guard lock(mutex);
+        auto end = first_after(through_version);
+        for (auto it = entries.cbegin(); it != end; ++it) {
+            if (it->id) latest.erase(it->id);
+            else --superseded;
+        }
+        entries.erase(entries.cbegin(), end);
+    }
+
+    // Registers a reader positioned at the current version. The log holds the cursor
+    // weakly, so a reader that goes away simply stops holding back trimming.
+    Cursor follow() {
+        std::lock_guard lock(mutex);
+        Cursor cursor = std::make_shared<size_t>(version.load(std::memory_order_relaxed));
+        cursors.push_back(cursor);
+        return cursor;
+    }
+
+    // Moves a reader to the current version, then forgets the changes every live cursor has handled.
+    void advance(const Cursor& cursor) {
+        size_t oldest;
+        {
+            std::lock_guard lock(mutex);
+            oldest = version.load(std::memory_order_relaxed);
+            *cursor = oldest;
+            std::erase_if(cursors, [&](const std::weak_ptr<size_t>& c) {
+                Cursor live = c.lock();
+                if (live) oldest = std::min(oldest, *live);
+                return !live;
+            });
+        }
+        trim(oldest);
+    }
+
+    // The number of IDs with a recorded change.
+    size_t size() const { return latest.size(); }
+    void clear() { std::lock_guard lock(mutex); entries.clear(); latest.clear(); superseded = 0; }
+
+private:
+    std::mutex mutex;
+    std::vector<std::weak_ptr<size_t>> cursors; // The readers `advance` trims for.
+
+    std::pmr::vector<Change>::const_iterator first_after(size_t v) const {
+        return std::upper_bound(entries.begin(), entries.end(), v, [](size_t v, const Change& c) { return v < c.version; });
+    }
+    Change& entry(size_t v) { return entries[size_t(first_after(v - 1) - entries.cbegin())]; }
+
+    // Drops superseded entries. Versions stay ascending, so lookups by version still work.
+    void compact() {
+        entries.erase(std::remove_if(entries.begin(), entries.end(), [](const Change& c) { return !c.id; }), entries.end());
+        superseded = 0;
+    }
+};
+#pragma endregion
+
+#pragma region Datums
+// -----------------------------------------------------------------------------
+// Datum: Associates a unique data value with each token.
+// This is the most common type of datum.
+// -----------------------------------------------------------------------------
+template<class T>
+struct Datum : Registered<Datum<T>> {
+    static constexpr bool tracks_members = true;
+
+    std::pmr::unordered_map<size_t, T> data;
+    Change_Log log;  // Records which tokens were written, once `track` is called.
+    T invalid = T(); // Returned for the invalid (0) token; each datum owns its own.
+    Datum_Stats stats;
+
+    Datum(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) : data(resource), log(resource) {}
+
+    // Accesses (or creates) the data associated with a specific token ID.
+    T& operator [] (const size_t& token) {
+        if (!token) { stats.miss(); return invalid; }
+        auto [it, fresh] = data.try_emplace(token);
+        if (fresh) { stats.insert(); this->joined(token); }
+        else stats.hit();
+        log.record(token, fresh ? Change_Log::Kind::Added : Change_Log::Kind::Changed);
+        return it->second;
+    }
+
+    // Turns change tracking on or off. While on, `operator []`, `token + datum`, `assign`
+    // and removals record the token; writes through `find` are reported with `touch`.
+    Change_Log& track(bool on = true) { log.enabled = on; return log; }
+    void touch(size_t token) { log.record(token, Change_Log::Kind::Changed); }
+
+    // Returns the token's data, or nullptr if it has none. Never inserts.
+    T* find(size_t token) {
+        auto it = data.find(token);
+        if (it == data.end()) { stats.miss(); return nullptr; }
+        stats.hit();
+        return &it->second;
+    }
+    const T* find(size_t token) const { auto it = data.find(token); return it == data.end() ? nullptr : &it->second; }
+    bool contains(size_t token) const { return data.contains(token); }
+
+    // Removes the data of one or several tokens.
+    void erase(size_t token) {
+        if (!data.erase(token)) return;
+        this->left(token);
+        log.record(token, Change_Log::Kind::Removed);
+    }
+    void erase(std::span<const size_t> itokens) { for (size_t token : itokens) erase(token); }
+
+    // Gives each `to` token a copy of `from`'s value, if it has one.
+    void clone(size_t from, std::span<const size_t> to) {
+        if (const T* value = std::as_const(*this).find(from)) assign(to, T(*value));
+    }
+
+    // Gives each token the value at the same position, creating entries as needed.
+    // The table is grown once up front instead of rehashing along the way.
+    void assign(std::span<const size_t> itokens, std::span<const T> values) {
+        assert(itokens.size() == values.size() && "Datum::assign needs one value per token.");
+        data.reserve(data.size() + itokens.size());
+        for (size_t i = 0; i < itokens.size(); ++i) if (itokens[i]) assigned(itokens[i], data.insert_or_assign(itokens[i], values[i]).second);
+    }
+    // Gives every token the same value.
+    void assign(std::span<const size_t> itokens, const T& value) {
+        data.reserve(data.size() + itokens.size());
+        for (size_t token : itokens) if (token) assigned(token, data.insert_or_assign(token, value).second);
+    }
+
+private:
+    void assigned(size_t token, bool fresh) {
+        if (fresh) this->joined(token);
+        log.record(token, fresh ? Change_Log::Kind::Added : Change_Log::Kind::Changed);
+    }
+};
+
+// -----------------------------------------------------------------------------
+// Dense_Datum: Associates a unique data value with each token, like Datum, but
+// keeps the values in one contiguous array parallel to a Token_Set.
+// Iterating `data` is a linear memory scan; removal swaps the last value into the hole,
+// so references are only valid until the next insert or removal.
+// -----------------------------------------------------------------------------
+template<class T>
+struct Dense_Datum : Registered<Dense_Datum<T>> {
+    static constexpr bool tracks_members = true;
+
+    Token_Set tokens;          // The token IDs, in the same order as `data`.
+    std::pmr::vector<T> data;  // The values, packed contiguously.
+    Change_Log log;            // Records which tokens were written, once `track` is called.
+    T invalid = T();           // Returned for the invalid (0) token; each datum owns its own.
+    Datum_Stats stats;
+
+    Dense_Datum(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) : tokens(resource), data(resource), log(resource) {}
+
+    // Accesses (or creates) the data associated with a specific token ID.
+    T& operator [] (const size_t& token) {
+        if (!token) { stats.miss(); return invalid; }
+        return insert(token);
+    }
+
+    // Turns change tracking on or off. While on, `operator []`, `insert`, `assign` and
+    // removals record the token; writes through `find` or `data` are reported with `touch`.
+    Change_Log& track(bool on = true) { log.enabled = on; return log; }
+    void touch(size_t token) { log.record(token, Change_Log::Kind::Changed); }
+
+    // Returns the token's data, or nullptr if it has none. Never inserts.
+    T* find(size_t token) {
+        size_t i = tokens.index(token);
+        if (i == Token_Set::npos) { stats.miss(); return nullptr; }
+        stats.hit();
+        return &data[i];
+    }
+    const T* find(size_t token) const { size_t i = tokens.index(token); return i == Token_Set::npos ? nullptr : &data[i]; }
+    bool contains(size_t token) const { return tokens.contains(token); }
+
+    // Returns the token's value, appending a default one if it has none.
+    T& insert(size_t token) {
+        size_t i = tokens.index(token);
+        if (i != Token_Set::npos) {
+            stats.hit();
+            log.record(token, Change_Log::Kind::Changed);
+            return data[i];
+        }
+        stats.insert();
+        i = tokens.insert(token);
+        if (i == data.size()) data.emplace_back();
+        else data[i] = T(); // The slot belonged to a stale ID of the same slot.
+        this->joined(token);
+        log.record(token, Change_Log::Kind::Added);
+        return data[i];
+    }
+
+    // Removes the token's value by moving the last value into its slot.
+    void erase(size_t token) {
+        size_t i = tokens.erase(token);
+        if (i == Token_Set::npos) return;
+        if (i != data.size() - 1) data[i] = std::move(data.back());
+        data.pop_back();
+        this->left(token);
+        log.record(token, Change_Log::Kind::Removed);
+    }
+    void erase(std::span<const size_t> itokens) { for (size_t token : itokens) erase(token); }
+
+    // Gives each `to` token a copy of `from`'s value, if it has one.
+    void clone(size_t from, std::span<const size_t> to) {
+        if (const T* value = std::as_const(*this).find(from)) assign(to, T(*value));
+    }
+
+    // Gives each token the value at the same position, appending values for new tokens.
+    // Tokens not yet present are added in one step, so ascending IDs append as one sorted run.
+    void assign(std::span<const size_t> itokens, std::span<const T> values) {
+        assert(itokens.size() == values.size() && "Dense_Datum::assign needs one value per token.");
+        size_t before = data.size();
+        tokens.insert(itokens);
+        data.resize(tokens.size());
+        for (size_t i = 0; i < itokens.size(); ++i) if (itokens[i]) assigned(itokens[i], before) = values[i];
+    }
+    // Gives every token the same value.
+    void assign(std::span<const size_t> itokens, const T& value) {
+        size_t before = data.size();
+        tokens.insert(itokens);
+        data.resize(tokens.size());
+        for (size_t token : itokens) if (token) assigned(token, before) = value;
+    }
+
+    // Reorders tokens and values together into ascending token order.
+    void sort() {
+        if (tokens.sorted) return;
+        std::vector<size_t> order(tokens.size());
+        for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+        std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return Token_Set::slot(tokens.dense[a]) < Token_Set::slot(tokens.dense[b]); });
+        std::pmr::vector<T> sorted(data.get_allocator());
+        sorted.reserve(data.size());
+        for (size_t i : order) sorted.push_back(std::move(data[i]));
+        data = std::move(sorted);
+        tokens.sort();
+    }
+
+    // Reorders the datum so that its first `order.size()` values belong to the given
+    // tokens, in that order, and returns them as one contiguous column.
+    // Tokens without a value get a default one, as with `operator []`.
+    // Already-aligned datums are only verified, so repeated calls cost one pass.
+    std::span<T> align(std::span<const size_t> order) {
+        for (size_t i = 0; i < order.size(); ++i) {
+            size_t j = tokens.index(order[i]);
+            if (j == Token_Set::npos) { insert(order[i]); j = tokens.index(order[i]); }
+            if (j == i) continue;
+            tokens.swap_positions(i, j);
+            std::swap(data[i], data[j]);
+        }
+        return std::span<T>(data.data(), order.size());
+    }
+
+    size_t size() const { return data.size(); }
+
+private:
+    // Records an assigned token as added if its position lies past the old end.
+    T& assigned(size_t token, size_t before) {
+        size_t i = tokens.index(token);
+        if (i >= before) this->joined(token);
+        log.record(token, i < before ? Change_Log::Kind::Changed : Change_Log::Kind::Added);
+        return data[i];
+    }
+};
+
+// -----------------------------------------------------------------------------
+// Paged_Datum: Associates a unique data value with each token, like Datum, in
+// fixed-size pages indexed by the token's slot.
+// A value stays where it was created for as long as its token has it, so references
+// from `token + datum` survive any number of other inserts and removals. Growth never
+// rehashes or moves values; the first token in a new range of slots allocates one
+// page, so no insert costs more than a page. The registry recycles slots, so pages
+// stay densely filled. `reserve(n)` allocates the pages for slots below n up front.
+// Iteration visits tokens in ascending slot order.
+// -----------------------------------------------------------------------------
+template<class T>
+struct Paged_Datum : Registered<Paged_Datum<T>> {
+    static constexpr bool tracks_members = true;
+    // Values per page: a power of two, sized so a page's values span about 16 KiB.
+    static constexpr size_t page_size = std::bit_floor(std::max<size_t>(64, 16384 / sizeof(T)));
+    static constexpr size_t page_bits = std::countr_zero(page_size);
+
+    struct Page {
+        size_t ids[page_size] = {};                          // The token in each slot, 0 if empty.
+        alignas(T) std::byte storage[page_size * sizeof(T)]; // Values, constructed for occupied slots only.
+        size_t count = 0;                                    // Occupied slots.
+
+        T* at(size_t i) { return std::launder(reinterpret_cast<T*>(storage) + i); }
+        const T* at(size_t i) const { return std::launder(reinterpret_cast<const T*>(storage) + i); }
+    };
+
+    std::pmr::vector<Page*> pages; // Page p holds slots [p * page_size, (p + 1) * page_size); null until used.
+    Change_Log log;                // Records which tokens were written, once `track` is called.
+    T invalid = T();               // Returned for the invalid (0) token; each datum owns its own.
+    Datum_Stats stats;
+
+    Paged_Datum(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) : pages(resource), log(resource) {}
+    // Copies get pages of their own, allocated like those of a default-constructed datum;
+    // an assigned-to datum keeps its memory resource, as the other datums' maps do.
+    Paged_Datum(const Paged_Datum& other) : Registered<Paged_Datum<T>>(other), log(other.log), invalid(other.invalid) { copy(other); }
+    Paged_Datum& operator = (const Paged_Datum& other) {
+        if (this == &other) return *this;
+        Registered<Paged_Datum<T>>::operator = (other);
+        release();
+        log = other.log;
+        invalid = other.invalid;
+        copy(other);
+        return *this;
+    }
+    ~Paged_Datum() { release(); }
+
+    // Accesses (or creates) the data associated with a specific token ID.
+    T& operator [] (const size_t& token) {
+        if (!token) { stats.miss(); return invalid; }
+        return insert(token);
+    }
+
+    // Turns change tracking on or off. While on, `operator []`, `insert`, `assign` and
+    // removals record the token; writes through `find` are reported with `touch`.
+    Change_Log& track(bool on = true) { log.enabled = on; return log; }
+    void touch(size_t token) { log.record(token, Change_Log::Kind::Changed); }
+
+    // Returns the token's data, or nullptr if it has none. Never inserts.
+    T* find(size_t token) {
+        T* value = const_cast<T*>(std::as_const(*this).find(token));
+        if (value) stats.hit(); else stats.miss();
+        return value;
+    }
+    const T* find(size_t token) const {
+        size_t s = Token_Registry::index_of(token), p = s >> page_bits;
+        if (!token || p >= pages.size() || !pages[p] || pages[p]->ids[s & (page_size - 1)] != token) return nullptr;
+        return pages[p]->at(s & (page_size - 1));
+    }
+    bool contains(size_t token) const { return find(token) != nullptr; }
+
+    // Returns the token's value, creating a default one if it has none.
+    T& insert(size_t token) {
+        size_t s = Token_Registry::index_of(token);
+        Page& page = page_of(s);
+        size_t i = s & (page_size - 1);
+        if (page.ids[i] == token) {
+            stats.hit();
+            log.record(token, Change_Log::Kind::Changed);
+            return *page.at(i);
+        }
+        stats.insert();
+        if (page.ids[i]) *page.at(i) = T(); // The slot belonged to a stale ID of the same slot.
+        else { std::construct_at(page.at(i)); ++page.count; ++count; }
+        page.ids[i] = token;
+        this->joined(token);
+        log.record(token, Change_Log::Kind::Added);
+        return *page.at(i);
+    }
+
+    // Removes the data of one or several tokens. Empty pages are kept for reuse.
+    void erase(size_t token) {
+        size_t s = Token_Registry::index_of(token), p = s >> page_bits, i = s & (page_size - 1);
+        if (!token || p >= pages.size() || !pages[p] || pages[p]->ids[i] != token) return;
+        std::destroy_at(pages[p]->at(i));
+        pages[p]->ids[i] = 0;
+        --pages[p]->count;
+        --count;
+        this->left(token);
+        log.record(token, Change_Log::Kind::Removed);
+    }
+    void erase(std::span<const size_t> itokens) { for (size_t token : itokens) erase(token); }
+
+    // Gives each `to` token a copy of `from`'s value, if it has one.
+    void clone(size_t from, std::span<const size_t> to) {
+        if (const T* value = std::as_const(*this).find(from)) assign(to, T(*value));
+    }
+
+    // Gives each token the value at the same position, creating entries as needed.
+    // The page table is grown once up front.
+    void assign(std::span<const size_t> itokens, std::span<const T> values) {
+        assert(itokens.size() == values.size() && "Paged_Datum::assign needs one value per token.");
+        reserve_for(itokens);
+        for (size_t i = 0; i < itokens.size(); ++i) if (itokens[i]) insert(itokens[i]) = values[i];
+    }
+    // Gives every token the same value.
+    void assign(std::span<const size_t> itokens, const T& value) {
+        reserve_for(itokens);
+        for (size_t token : itokens) if (token) insert(token) = value;
+    }
+
+    // Allocates the pages for slots below `n`, so tokens in them never allocate.
+    void reserve(size_t n) {
+        size_t needed = (n + page_size - 1) >> page_bits;
+        if (needed > pages.size()) pages.resize(needed, nullptr);
+        for (size_t p = 0; p < needed; ++p) if (!pages[p]) allocate(p);
+    }
+
+    // Calls `f(token, value)` for every token with a value, in ascending slot order.
+    template<class F> void each(F&& f) {
+        for (Page* page : pages) {
+            if (!page || !page->count) continue;
+            for (size_t i = 0; i < page_size; ++i) if (page->ids[i]) f(page->ids[i], *page->at(i));
+        }
+    }
+
+    size_t size() const { return count; }
+    // The number of values the allocated pages can hold.
+    size_t capacity() const { size_t n = 0; for (Page* page : pages) n += page ? page_size : 0; return n; }
+
+private:
+    size_t count = 0; // Tokens with a value.
+
+    Page& page_of(size_t s) {
+        size_t p = s >> page_bits;
+        if (p >= pages.size()) pages.resize(std::max(p + 1, pages.size() * 2), nullptr);
+        return pages[p] ? *pages[p] : allocate(p);
+    }
+    Page& allocate(size_t p) {
+        std::pmr::polymorphic_allocator<Page> allocator(pages.get_allocator().resource());
+        pages[p] = allocator.template new_object<Page>();
+        return *pages[p];
+    }
+    // Destroys every value and page.
+    void release() {
+        std::pmr::polymorphic_allocator<Page> allocator(pages.get_allocator().resource());
+        for (Page* page : pages) {
+            if (!page) continue;
+            for (size_t i = 0; i < page_size; ++i) if (page->ids[i]) std::destroy_at(page->at(i));
+            allocator.delete_object(page);
+        }
+        pages.clear();
+        count = 0;
+    }
+    // Copies another datum's pages slot by slot. This datum must be empty.
+    void copy(const Paged_Datum& other) {
+        pages.resize(other.pages.size(), nullptr);
+        for (size_t p = 0; p < other.pages.size(); ++p) {
+            const Page* source = other.pages[p];
+            if (!source) continue;
+            Page& page = allocate(p);
+            for (size_t i = 0; i < page_size; ++i) {
+                if (!source->ids[i]) continue;
+                std::construct_at(page.at(i), *source->at(i));
+                page.ids[i] = source->ids[i];
+                ++page.count;
+            }
+        }
+        count = other.count;
+    }
+    // Grows the page table to cover every given slot at once.
+    void reserve_for(std::span<const size_t> itokens) {
+        size_t top = 0;
+        for (size_t token : itokens) top = std::max(top, Token_Registry::index_of(token));
+        if ((top >> page_bits) >= pages.size()) pages.resize((top >> page_bits) + 1, nullptr);
+    }
+};
+
+// -----------------------------------------------------------------------------
+// Static_Datum: Shares a single data instance among a subscribed set of tokens.
+// Useful for properties that are constant across a group.
+// -----------------------------------------------------------------------------
+template<class T>
+struct Static_Datum : Registered<Static_Datum<T>> {
+    static constexpr bool tracks_members = true;
+
+    T data;
+    std::pmr::unordered_set<size_t> tokens;
+    T invalid = T(); // Returned to unsubscribed tokens; each datum owns its own.
+    Datum_Stats stats;
+
+    Static_Datum(const T& idata, std::pmr::memory_resource* resource = std::pmr::get_default_resource()) : data(idata), tokens(resource) {}
+
+    // Subscribes one or several tokens, growing the set once.
+    void insert(size_t token) { if (token && tokens.insert(token).second) this->joined(token); }
+    void insert(std::span<const size_t> itokens) {
+        tokens.reserve(tokens.size() + itokens.size());
+        for (size_t token : itokens) insert(token);
+    }
+    // Unsubscribes one or several tokens.
+    void erase(size_t token) { if (tokens.erase(token)) this->left(token); }
+    void erase(std::span<const size_t> itokens) { for (size_t token : itokens) erase(token); }
+
+    // Subscribes the `to` tokens if `from` is subscribed.
+    void clone(size_t from, std::span<const size_t> to) { if (contains(from)) insert(to); }
+
+    // Accesses the shared data if the token is in the subscribed set.
+    T& operator [] (size_t token) {
+        if (!tokens.contains(token)) { stats.miss(); return invalid; }
+        stats.hit();
+        return data;
+    }
+
+    // Returns the shared data if the token is subscribed, or nullptr.
+    T* find(size_t token) { return tokens.contains(token) ? &data : nullptr; }
+    const T* find(size_t token) const { return tokens.contains(token) ? &data : nullptr; }
+    bool contains(size_t token) const { return tokens.contains(token); }
+
+    // Allows direct access to the underlying data.
+    operator T& () { return data; }
+};
+
+// -----------------------------------------------------------------------------
+// Solitary_Datum: A data instance that can only be associated with a single token.
+// -----------------------------------------------------------------------------
+template<class T>
+struct Solitary_Datum : Registered<Solitary_Datum<T>> {
+    T data;
+    size_t token = 0; // The ID of the single associated token.
+    T invalid = T();  // Returned to every other token; each datum owns its own.
+
+    Solitary_Datum(const T& idata) : data(idata) {}
+
+    // Releases the datum if its token is among the given ones.
+    void erase(std::span<const size_t> itokens) {
+        if (std::find(itokens.begin(), itokens.end(), token) != itokens.end()) token = 0;
+    }
+
+    // Accesses the data only if the requesting token's ID matches the stored one.
+    T& operator [] (size_t itoken) {
+        if (!contains(itoken)) return invalid;
+        return data;
+    }
+
+    // Returns the data if the token is the associated one, or nullptr.
+    T* find(size_t itoken) { return contains(itoken) ? &data : nullptr; }
+    const T* find(size_t itoken) const { return contains(itoken) ? &data : nullptr; }
+    bool contains(size_t itoken) const { return itoken && itoken == token; }
+    void operator = (T& idata) { data = idata; }
+};
+
+// -----------------------------------------------------------------------------
+// Shared_Datum: Allows distinct groups of tokens to share data instances.
+// Tokens are mapped to a "pool" of data.
+// Pool values live in a dense array indexed by pool ID, so an access is one hash
+// lookup plus an array index. Each pool counts its tokens and is reclaimed, and
+// its ID reused, when the last one leaves. `intern` joins a token to an existing
+// pool holding an equal value instead of creating a duplicate.
+// References to pool values are valid until the next pool is created.
+// With tracking on, `log` records tokens joining, moving and leaving, and `pool_log`
+// records pool IDs whose value was created, written or reclaimed. The mutable
+// `operator []` and `value` count as writes; read through a const datum, or with `find`,
+// to leave `pool_log` alone.
+// -----------------------------------------------------------------------------
+template<class T>
+struct Shared_Datum : Registered<Shared_Datum<T>> {
+    static constexpr size_t npos = ~size_t(0);
+    static constexpr bool tracks_members = true;
+
+    std::pmr::unordered_map<size_t, size_t> pools;          // Maps a token ID to a data pool ID.
+    std::pmr::vector<T> data;                               // Stores the data for each pool, at index ID - 1.
+    std::pmr::vector<size_t> refs;                          // The number of tokens in each pool; 0 marks a free ID.
+    std::pmr::vector<size_t> keys;                          // The hash each pool was interned under, or npos.
+    std::pmr::vector<size_t> free;                          // Reclaimed pool IDs, reused before new ones.
+    std::pmr::unordered_multimap<size_t, size_t> interned;  // Maps a value hash to the interned pools holding it.
+    size_t count = 0;                                       // The most recently created pool (0 = none).
+    Change_Log log;                                         // Records membership changes by token ID.
+    Change_Log pool_log;                                    // Records value changes by pool ID.
+    T invalid = T();                                        // Returned to tokens in no pool; each datum owns its own.
+    Datum_Stats stats;
+
+    Shared_Datum(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : pools(resource), data(resource), refs(resource), keys(resource), free(resource), interned(resource), log(resource), pool_log(resource) {}
+
+    // Turns change tracking on or off for both logs. Writes through `find` are reported with `touch`.
+    void track(bool on = true) { log.enabled = on; pool_log.enabled = on; }
+    void touch(size_t pool) { pool_log.record(pool, Change_Log::Kind::Changed); }
+
+    // Removes several tokens from their pools.
+    void erase(std::span<const size_t> tokens) { for (size_t token : tokens) leave(token); }
+
+    // Joins the `to` tokens to `from`'s pool, so they share its value.
+    void clone(size_t from, std::span<const size_t> to) {
+        auto it = pools.find(from);
+        if (it != pools.end()) join(to, it->second);
+    }
+
+    // Accesses the data from the pool associated with the given token, recording the pool as written.
+    T& operator [] (size_t& token) {
+        auto it = pools.find(token);
+        if (it == pools.end()) { stats.miss(); return invalid; }
+        stats.hit();
+        return value(it->second);
+    }
+    // Reads the data of the token's pool without recording it.
+    const T& operator [] (size_t token) const {
+        auto it = pools.find(token);
+        return it == pools.end() ? invalid : data[it->second - 1];
+    }
+
+    // Returns the data of the token's pool, or nullptr if it is in none.
+    T* find(size_t token) {
+        auto it = pools.find(token);
+        if (it == pools.end()) { stats.miss(); return nullptr; }
+        stats.hit();
+        return &data[it->second - 1];
+    }
+    const T* find(size_t token) const { auto it = pools.find(token); return it == pools.end() ? nullptr : &data[it->second - 1]; }
+    bool contains(size_t token) const { return pools.contains(token); }
+
+    // Accesses a pool's data by pool ID; the mutable form records the pool as written.
+    T& value(size_t pool) { pool_log.record(pool, Change_Log::Kind::Changed); return data[pool - 1]; }
+    const T& value(size_t pool) const { return data[pool - 1]; }
+
+    // Creates an empty pool holding `ivalue` and returns its ID. It becomes the most recent pool.
+    size_t create(const T& ivalue = T()) {
+        size_t pool;
+        if (!free.empty()) {
+            pool = free.back();
+            free.pop_back();
+            data[pool - 1] = ivalue;
+        }
+        else {
+            data.push_back(ivalue);
+            refs.push_back(0);
+            keys.push_back(npos);
+            pool = data.size();
+        }
+        count = pool;
+        pool_log.record(pool, Change_Log::Kind::Added);
+        return pool;
+    }
+
+    // Sets the value of a given pool ID, creating the pool if it does not exist. Lets a
+    // replica keep the same pool IDs as the datum it mirrors (see Delta_Decoder).
+    void place(size_t pool, const T& ivalue) {
+        if (pool > data.size()) {
+            data.resize(pool);
+            refs.resize(pool, 0);
+            keys.resize(pool, npos);
+        }
+        else if (!refs[pool - 1]) {
+            auto it = std::find(free.begin(), free.end(), pool);
+            if (it != free.end()) free.erase(it);
+        }
+        data[pool - 1] = ivalue;
+        pool_log.record(pool, Change_Log::Kind::Changed);
+    }
+
+    // Moves a token into an existing pool, leaving its previous one.
+    void join(size_t token, size_t pool) {
+        auto [it, fresh] = pools.try_emplace(token, pool);
+        if (!fresh) {
+            if (it->second == pool) return;
+            release(it->second);
+            it->second = pool;
+        }
+        ++refs[pool - 1];
+        if (fresh) this->joined(token);
+        log.record(token, fresh ? Change_Log::Kind::Added : Change_Log::Kind::Changed);
+    }
+    // Moves several tokens into one pool, growing the token map once.
+    void join(std::span<const size_t> tokens, size_t pool) {
+        pools.reserve(pools.size() + tokens.size());
+        for (size_t token : tokens) if (token) join(token, pool);
+    }
+
+    // Removes a token from its pool, reclaiming the pool if it was the last member.
+    void leave(size_t token) {
+        auto it = pools.find(token);
+        if (it == pools.end()) return;
+        size_t pool = it->second;
+        pools.erase(it);
+        release(pool);
+        this->left(token);
+        log.record(token, Change_Log::Kind::Removed);
+    }
+
+    // Joins a token to a pool whose value equals `ivalue`, creating one if none exists.
+    // Requires std::hash<T> and operator ==. A pool's value should not change while
+    // other tokens may still intern against it.
+    size_t intern(size_t token, const T& ivalue) {
+        size_t key = std::hash<T>{}(ivalue);
+        auto [begin, end] = interned.equal_range(key);
+        for (auto it = begin; it != end; ++it) {
+            if (data[it->second - 1] == ivalue) { join(token, it->second); return it->second; }
+        }
+        size_t pool = create(ivalue);
+        keys[pool - 1] = key;
+        interned.emplace(key, pool);
+        join(token, pool);
+        return pool;
+    }
+
+    // The number of pools that currently have tokens.
+    size_t live() const { return data.size() - free.size(); }
+
+private:
+    void release(size_t pool) {
+        if (--refs[pool - 1]) return;
+        if (keys[pool - 1] != npos) {
+            auto [begin, end] = interned.equal_range(keys[pool - 1]);
+            for (auto it = begin; it != end; ++it) if (it->second == pool) { interned.erase(it); break; }
+            keys[pool - 1] = npos;
+        }
+        data[pool - 1] = T(); // Drop whatever the value owned.
+        free.push_back(pool);
+        pool_log.record(pool, Change_Log::Kind::Removed);
+        if (count == pool) count = 0;
+    }
+};
+
+// -----------------------------------------------------------------------------
+// Concurrent_Datum: Associates a unique data value with each token and may be
+// used from several threads at once.
+// Tokens are spread over independently locked shards, so threads touching
+// different tokens rarely contend. Reads take a shared lock and never insert;
+// values are copied out rather than referenced, since a reference would outlive the lock.
+// -----------------------------------------------------------------------------
+template<class T>
+struct Concurrent_Datum : Registered<Concurrent_Datum<T>> {
+    static constexpr size_t shard_count = 64;
+
+    struct alignas(64) Shard {
+        mutable std::shared_mutex mutex;
+        std::pmr::unordered_map<size_t, T> data;
+    };
+    std::unique_ptr<Shard[]> shards = std::make_unique<Shard[]>(shard_count);
+
+    Concurrent_Datum(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) {
+        for (size_t i = 0; i < shard_count; ++i) rebuild_on(shards[i].data, resource);
+    }
+
+    // A handle to one token's value. Assigning writes it, converting reads it.
+    struct Entry {
+        Concurrent_Datum& datum;
+        size_t token;
+
+        Entry& operator = (const T& value) { datum.set(token, value); return *this; }
+        operator T () const { return datum.find(token).value_or(T{}); }
+    };
+
+    Entry operator [] (size_t token) { return { *this, token }; }
+
+    // Returns a copy of the token's value, or nothing if it has none. Never inserts.
+    std::optional<T> find(size_t token) const {
+        Shard& shard = shard_of(token);
+        std::shared_lock lock(shard.mutex);
+        auto it = shard.data.find(token);
+        if (it == shard.data.end()) return std::nullopt;
+        return it->second;
+    }
+
+    bool contains(size_t token) const {
+        Shard& shard = shard_of(token);
+        std::shared_lock lock(shard.mutex);
+        return shard.data.contains(token);
+    }
+
+    // Calls `f(const T&)` under a shared lock if the token has a value; returns whether it did.
+    template<class F> bool read(size_t token, F&& f) const {
+        Shard& shard = shard_of(token);
+        std::shared_lock lock(shard.mutex);
+        auto it = shard.data.find(token);
+        if (it == shard.data.end()) return false;
+        const T& value = it->second;
+        f(value);
+        return true;
+    }
+
+    // Calls `f(T&)` under an exclusive lock, creating a default value on a miss.
+    template<class F> void update(size_t token, F&& f) {
+        Shard& shard = shard_of(token);
+        std::unique_lock lock(shard.mutex);
+        f(shard.data[token]);
+    }
+
+    void set(size_t token, const T& value) { update(token, [&](T& v) { v = value; }); }
+
+    // Gives each `to` token a copy of `from`'s value, if it has one.
+    void clone(size_t from, std::span<const size_t> to) {
+        if (std::optional<T> value = find(from)) for (size_t token : to) if (token) set(token, *value);
+    }
+
+    // Removes the token's value and returns it, or a default value if it had none.
+    T take(size_t token) {
+        Shard& shard = shard_of(token);
+        std::unique_lock lock(shard.mutex);
+        auto it = shard.data.find(token);
+        if (it == shard.data.end()) return T{};
+        T val = std::move(it->second);
+        shard.data.erase(it);
+        return val;
+    }
+
+    // Removes the values of several tokens, locking each affected shard once.
+    void erase(std::span<const size_t> tokens) {
+        std::vector<size_t> order(tokens.begin(), tokens.end());
+        std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return shard_index(a) < shard_index(b); });
+        for (size_t i = 0; i < order.size();) {
+            Shard& shard = shards[shard_index(order[i])];
+            std::unique_lock lock(shard.mutex);
+            size_t s = shard_index(order[i]);
+            for (; i < order.size() && shard_index(order[i]) == s; ++i) shard.data.erase(order[i]);
+        }
+    }
+
+    // The number of tokens with a value. Not a snapshot while writers are active.
+    size_t size() const {
+        size_t n = 0;
+        for (size_t i = 0; i < shard_count; ++i) {
+            std::shared_lock lock(shards[i].mutex);
+            n += shards[i].data.size();
+        }
+        return n;
+    }
+
+    static size_t shard_index(size_t token) { return std::hash<size_t>{}(token) % shard_count; }
+    Shard& shard_of(size_t token) const { return shards[shard_index(token)]; }
+};
+
+// -----------------------------------------------------------------------------
+// Buffered_Datum: A Datum kept in N copies (two by default), so reader threads such
+// as rendering or networking see the last published frame while the simulation
+// writes the next one.
+// The writer uses the back copy exactly like a Datum. `publish` hands it to readers
+// with one atomic store, then brings the copy that becomes the new back up to date
+// by copying only the entries written since it was last the back copy, as recorded
+// in `dirty`. There are no per-frame full copies.
+// Readers call `read()` for a View of the published copy. Pinning it is one atomic
+// increment plus a check, with no locks, and the values cannot change while the View
+// lives. With two copies, `publish` waits for readers still holding the copy it is
+// about to reuse. A third copy lets it skip past them, so readers may lag a frame.
+// Only one thread publishes at a time, and publishing must not overlap writes.
+// -----------------------------------------------------------------------------
+template<class T, size_t N>
+struct Buffered_Datum : Registered<Buffered_Datum<T, N>> {
+    static_assert(N >= 2, "A Buffered_Datum needs at least two copies.");
+    static constexpr bool tracks_members = true;
+
+    struct alignas(64) Buffer {
+        std::pmr::unordered_map<size_t, T> data;
+        size_t frame = 0;                               // The publish that last made this copy current.
+        size_t synced = 0;                              // The `dirty` version this copy has caught up with.
+        mutable std::atomic<size_t> readers = 0;        // Views pinning this copy.
+    };
+
+    // A pinned, read-only view of one published frame. Move-only; unpins when destroyed.
+    struct View {
+        const Buffer* buffer = nullptr;
+
+        View(const Buffer* ibuffer) : buffer(ibuffer) {}
+        View(View&& other) noexcept : buffer(std::exchange(other.buffer, nullptr)) {}
+        View& operator = (View&& other) noexcept {
+            if (this != &other) { release(); buffer = std::exchange(other.buffer, nullptr); }
+            return *this;
+        }
+        ~View() { release(); }
+
+        const T* find(size_t token) const { auto it = buffer->data.find(token); return it == buffer->data.end() ? nullptr : &it->second; }
+        bool contains(size_t token) const { return buffer->data.contains(token); }
+        size_t size() const { return buffer->data.size(); }
+        // The publish this view shows; 0 before the first one.
+        size_t frame() const { return buffer->frame; }
+        // Calls `f(token, const T&)` for every entry, in no particular order.
+        template<class F> void each(F&& f) const { for (auto& [token, value] : buffer->data) f(token, value); }
+
+    private:
+        void release() { if (buffer) buffer->readers.fetch_sub(1); buffer = nullptr; }
+    };
+
+    std::unique_ptr<Buffer[]> buffers = std::make_unique<Buffer[]>(N);
+    std::atomic<size_t> front = 0; // The copy readers see.
+    size_t back = 1;               // The copy being written.
+    size_t frame = 0;              // The number of publishes so far.
+    Change_Log dirty;              // The tokens written since the oldest copy was last the back copy.
+    T invalid = T();               // Returned for the invalid (0) token; each datum owns its own.
+    Datum_Stats stats;
+
+    Buffered_Datum(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) : dirty(resource) {
+        for (size_t i = 0; i < N; ++i) rebuild_on(buffers[i].data, resource);
+        dirty.enabled = true;
+    }
+    Buffered_Datum(const Buffered_Datum&) = delete;
+    Buffered_Datum& operator = (const Buffered_Datum&) = delete;
+
+    // Accesses (or creates) the token's value in the back copy.
+    T& operator [] (const size_t& token) {
+        if (!token) { stats.miss(); return invalid; }
+        auto [it, fresh] = buffers[back].data.try_emplace(token);
+        if (fresh) { stats.insert(); this->joined(token); }
+        else stats.hit();
+        dirty.record(token, fresh ? Change_Log::Kind::Added : Change_Log::Kind::Changed);
+        return it->second;
+    }
+
+    // Returns the token's value in the back copy, or nullptr. Report writes through it with `touch`.
+    T* find(size_t token) {
+        auto it = buffers[back].data.find(token);
+        if (it == buffers[back].data.end()) { stats.miss(); return nullptr; }
+        stats.hit();
+        return &it->second;
+    }
+    const T* find(size_t token) const { auto it = buffers[back].data.find(token); return it == buffers[back].data.end() ? nullptr : &it->second; }
+    bool contains(size_t token) const { return buffers[back].data.contains(token); }
+    void touch(size_t token) { dirty.record(token, Change_Log::Kind::Changed); }
+
+    // Removes the back copy's value of one or several tokens. Readers keep seeing it until the next publish.
+    void erase(size_t token) {
+        if (!buffers[back].data.erase(token)) return;
+        this->left(token);
+        dirty.record(token, Change_Log::Kind::Removed);
+    }
+    void erase(std::span<const size_t> itokens) { for (size_t token : itokens) erase(token); }
+
+    // Gives each `to` token a copy of `from`'s value, if it has one.
+    void clone(size_t from, std::span<const size_t> to) {
+        if (const T* value = std::as_const(*this).find(from)) assign(to, T(*value));
+    }
+
+    // Gives each token the value at the same position, creating entries as needed.
+    void assign(std::span<const size_t> itokens, std::span<const T> values) {
+        assert(itokens.size() == values.size() && "Buffered_Datum::assign needs one value per token.");
+        buffers[back].data.reserve(buffers[back].data.size() + itokens.size());
+        for (size_t i = 0; i < itokens.size(); ++i) if (itokens[i]) assigned(itokens[i], buffers[back].data.insert_or_assign(itokens[i], values[i]).second);
+    }
+    // Gives every token the same value.
+    void assign(std::span<const size_t> itokens, const T& value) {
+        buffers[back].data.reserve(buffers[back].data.size() + itokens.size());
+        for (size_t token : itokens) if (token) assigned(token, buffers[back].data.insert_or_assign(token, value).second);
+    }
+
+    size_t size() const { return buffers[back].data.size(); }
+
+    // Makes the back copy the published one and returns its frame number. The next back
+    // copy is the least recently published one that no View pins, waiting if there is none,
+    // and it receives only the entries written since it was last the back copy.
+    size_t publish() {
+        Buffer& written = buffers[back];
+        written.frame = ++frame;
+        written.synced = dirty.version;
+        front.store(back);
+        size_t next = claim();
+        Buffer& target = buffers[next];
+        dirty.since(target.synced, [&](size_t token, Change_Log::Kind) {
+            auto it = written.data.find(token);
+            if (it == written.data.end()) target.data.erase(token);
+            else target.data.insert_or_assign(token, it->second);
+        });
+        target.synced = dirty.version;
+        back = next;
+        size_t oldest = dirty.version;
+        for (size_t i = 0; i < N; ++i) oldest = std::min(oldest, buffers[i].synced);
+        dirty.trim(oldest);
+        return frame;
+    }
+
+    // Pins the published copy. Safe from any thread, alongside the writer and other readers.
+    View read() const {
+        while (true) {
+            size_t i = front.load();
+            buffers[i].readers.fetch_add(1);
+            // A publish in between may be reusing this copy as its back copy; try the new front.
+            if (front.load() == i) return View(&buffers[i]);
+            buffers[i].readers.fetch_sub(1);
+        }
+    }
+
+private:
+    void assigned(size_t token, bool fresh) {
+        if (fresh) this->joined(token);
+        dirty.record(token, fresh ? Change_Log::Kind::Added : Change_Log::Kind::Changed);
+    }
+
+    // Picks the next back copy, oldest first, among the copies no View pins.
+    size_t claim() {
+        size_t published = front.load();
+        while (true) {
+            for (size_t k = 1; k < N; ++k) {
+                size_t candidate = (published + k) % N;
+                if (!buffers[candidate].readers.load()) return candidate;
+            }
+            std::this_thread::yield();
+        }
+    }
+};
+
+// -----------------------------------------------------------------------------
+// Archetype: Stores a fixed, compile-time set of values for each member token,
+// together, in chunked struct-of-arrays blocks.
+// Each chunk holds one array per type for `rows` tokens. A token's row is found
+// through a Token_Set, and a column's place inside a chunk is fixed at compile time,
+// so `token[Position]` is one array lookup plus a constant offset; no hashing.
+// Columns are named through `columns` and work like datums with Tokens, Behaviors,
+// Access declarations and Queries. Removal swaps the last row into the hole.
+// Usage: `Archetype<Vec3, Vec3, float> Projectile; auto& [Position, Velocity, Lifetime] = Projectile.columns;`
+// -----------------------------------------------------------------------------
+template<class T, class A, size_t I>
+struct Archetype_Column {
+    using value_type = T;
+
+    A* archetype = nullptr;
+
+    // Accesses the token's value in this column, or the column's invalid value if the token is not a member.
+    value_type& operator [] (size_t token) { value_type* value = find(token); return value ? *value : std::get<I>(archetype->invalid); }
+    value_type* find(size_t token) { size_t row = archetype->tokens.index(token); return row == Token_Set::npos ? nullptr : &archetype->template at<I>(row); }
+    bool contains(size_t token) const { return archetype->tokens.contains(token); }
+
+    // The column's values in one chunk, for batch processing. Row r of chunk c belongs to `archetype->tokens.dense[c * rows + r]`.
+    std::span<value_type> chunk(size_t c) {
+        return std::span<value_type>(std::get<I>(archetype->chunks[c]->columns).data(), std::min(A::rows, archetype->size() - c * A::rows));
+    }
+};
+
+// Maps an archetype and its column indices to the tuple of its column handles.
+template<class A, class Is> struct Archetype_Columns;
+template<class... Ts, size_t... Is> struct Archetype_Columns<Archetype<Ts...>, std::index_sequence<Is...>> {
+    using type = std::tuple<Archetype_Column<Ts, Archetype<Ts...>, Is>...>;
+};
+
+template<class... Ts>
+struct Archetype : Registered<Archetype<Ts...>> {
+    static_assert(sizeof...(Ts) > 0, "An Archetype needs at least one column.");
+    static constexpr bool tracks_members = true;
+
+    template<size_t I> using type = std::tuple_element_t<I, std::tuple<Ts...>>;
+
+    // Rows per chunk: a power of two, sized so a chunk spans about 16 KiB.
+    static constexpr size_t rows = std::bit_floor(std::max<size_t>(1, 16384 / (sizeof(Ts) + ...)));
+
+    struct Chunk { std::tuple<std::array<Ts, rows>...> columns; };
+
+    Token_Set tokens;                     // The member token IDs, in row order.
+    std::pmr::vector<Chunk*> chunks;      // The value blocks; row r lives in chunk r / rows.
+    std::tuple<Ts...> invalid{};          // Returned to tokens that are not members.
+
+    // One column handle per type, for use wherever a datum is expected.
+    typename Archetype_Columns<Archetype, std::index_sequence_for<Ts...>>::type columns;
+
+    Archetype(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) : tokens(resource), chunks(resource) {
+        std::apply([&](auto&... column) { ((column.archetype = this), ...); }, columns);
+    }
+    Archetype(const Archetype&) = delete;
+    Archetype& operator = (const Archetype&) = delete;
+    ~Archetype() {
+        std::pmr::polymorphic_allocator<Chunk> allocator(chunks.get_allocator().resource());
+        for (Chunk* chunk : chunks) allocator.delete_object(chunk);
+    }
+
+    // Returns the column holding values of the I-th type.
+    template<size_t I> Archetype_Column<type<I>, Archetype, I>& column() { return std::get<I>(columns); }
+
+    // Adds a token with default values, if it is not already a member, and returns its row.
+    size_t insert(size_t token) {
+        size_t row = tokens.index(token);
+        if (row != Token_Set::npos) return row;
+        row = tokens.insert(token);
+        if (row / rows >= chunks.size()) {
+            std::pmr::polymorphic_allocator<Chunk> allocator(chunks.get_allocator().resource());
+            chunks.push_back(allocator.template new_object<Chunk>());
+        }
+        reset(row, std::index_sequence_for<Ts...>{});
+        this->joined(token);
+        return row;
+    }
+
+    // Removes a token by moving the last row into its place.
+    void erase(size_t token) {
+        size_t row = tokens.erase(token);
+        if (row == Token_Set::npos) return;
+        size_t last = tokens.size();
+        if (row != last) move(last, row, std::index_sequence_for<Ts...>{});
+        reset(last, std::index_sequence_for<Ts...>{}); // Drop whatever the old last row owned.
+        this->left(token);
+    }
+    void erase(std::span<const size_t> itokens) { for (size_t token : itokens) erase(token); }
+
+    // Gives each `to` token a copy of `from`'s row, if it has one.
+    void clone(size_t from, std::span<const size_t> to) {
+        size_t source = tokens.index(from);
+        if (source == Token_Set::npos) return;
+        tokens.reserve(tokens.size() + to.size());
+        for (size_t token : to) if (token && token != from) copy(source, insert(token), std::index_sequence_for<Ts...>{});
+    }
+
+    // Returns the I-th value of a row. The offset within the chunk is a compile-time constant.
+    template<size_t I> type<I>& at(size_t row) { return std::get<I>(chunks[row / rows]->columns)[row % rows]; }
+
+    bool contains(size_t token) const { return tokens.contains(token); }
+    size_t size() const { return tokens.size(); }
+    // The number of chunks that hold at least one row.
+    size_t chunk_count() const { return (size() + rows - 1) / rows; }
+
+private:
+    template<size_t... Is> void reset(size_t row, std::index_sequence<Is...>) { ((at<Is>(row) = Ts()), ...); }
+    template<size_t... Is> void move(size_t from, size_t to, std::index_sequence<Is...>) { ((at<Is>(to) = std::move(at<Is>(from))), ...); }
+    template<size_t... Is> void copy(size_t from, size_t to, std::index_sequence<Is...>) { ((at<Is>(to) = at<Is>(from)), ...); }
+};
+
+// Names the class and value type of a pointer to data member, for Soa_Datum's field list.
+template<auto M> struct Member_Of;
+template<class C, class F, F C::* M> struct Member_Of<M> { using owner = C; using type = F; };
+
+// -----------------------------------------------------------------------------
+// Soa_Datum: Stores the listed fields of a struct in separate arrays, one per field,
+// keyed like a Dense_Datum by the token's dense position.
+// Every field array starts on a 64-byte boundary and position i of each belongs to
+// `tokens.dense[i]`, so a loop over x[], y[] and z[] is a straight vector loop (see
+// the Kernels region). `token[Position]` returns a Row handle that gathers the struct
+// when read and scatters it when assigned; `field<I>()` is the I-th array.
+// Fields must be trivially copyable. Removal swaps the last row into the hole.
+// Usage: `Soa_Datum<Vec3, &Vec3::x, &Vec3::y, &Vec3::z> Position;`
+// -----------------------------------------------------------------------------
+template<class T, auto... Fields>
+struct Soa_Datum : Registered<Soa_Datum<T, Fields...>> {
+    static_assert(sizeof...(Fields) > 0, "A Soa_Datum needs at least one field.");
+    static_assert((std::is_same_v<typename Member_Of<Fields>::owner, T> && ...), "Soa_Datum fields must be members of T.");
+    static_assert((std::is_trivially_copyable_v<typename Member_Of<Fields>::type> && ...), "Soa_Datum fields must be trivially copyable.");
+    static constexpr bool tracks_members = true;
+
+    static constexpr size_t alignment = 64;
+    template<size_t I> using type = std::tuple_element_t<I, std::tuple<typename Member_Of<Fields>::type...>>;
+
+    // A handle to one token's row. Converting gathers the fields, assigning scatters them.
+    // The invalid token's handle reads as T(), ignores writes, and yields the datum's `invalid` fields.
+    struct Row {
+        Soa_Datum* datum;
+        size_t row; // Token_Set::npos for the invalid token.
+
+        Row& operator = (const T& value) { if (row != Token_Set::npos) datum->scatter(row, value); return *this; }
+        operator T () const { return row != Token_Set::npos ? datum->gather(row) : T(); }
+        // The I-th field of the token's row.
+        template<size_t I> type<I>& get() const {
+            if (row == Token_Set::npos) return std::get<I>(datum->invalid);
+            return datum->template field<I>()[row];
+        }
+    };
+
+    Token_Set tokens;                                           // The token IDs, in row order.
+    std::tuple<typename Member_Of<Fields>::type*...> columns{}; // One aligned array per field, `capacity` rows each.
+    size_t capacity = 0;                                        // Rows allocated in every field.
+    std::pmr::memory_resource* resource;                        // Where the fields are allocated.
+    std::tuple<typename Member_Of<Fields>::type...> invalid{}; // Fields of the invalid (0) token; each datum owns its own.
+    Datum_Stats stats;
+
+    Soa_Datum(std::pmr::memory_resource* iresource = std::pmr::get_default_resource()) : tokens(iresource), resource(iresource) {}
+    Soa_Datum(const Soa_Datum&) = delete;
+    Soa_Datum& operator = (const Soa_Datum&) = delete;
+    ~Soa_Datum() { std::apply([&](auto*... column) { (release(column, capacity), ...); }, columns); }
+
+    // Accesses (or creates) the row associated with a specific token ID.
+    Row operator [] (size_t token) {
+        if (!token) { stats.miss(); return { this, Token_Set::npos }; }
+        return { this, insert(token) };
+    }
+
+    // Returns a copy of the token's value, or nothing if it has none. Never inserts.
+    std::optional<T> find(size_t token) {
+        size_t row = tokens.index(token);
+        if (row == Token_Set::npos) { stats.miss(); return std::nullopt; }
+        stats.hit();
+        return gather(row);
+    }
+    bool contains(size_t token) const { return tokens.contains(token); }
+
+    // Adds a token with a default value, if it has none, and returns its row.
+    size_t insert(size_t token) {
+        size_t row = tokens.index(token);
+        if (row != Token_Set::npos) { stats.hit(); return row; }
+        stats.insert();
+        row = tokens.insert(token);
+        if (tokens.size() > capacity) grow(tokens.size());
+        scatter(row, T()); // The row may have belonged to a stale ID of the same slot.
+        this->joined(token);
+        return row;
+    }
+
+    // Removes the token's row by moving the last row into its place.
+    void erase(size_t token) {
+        size_t row = tokens.erase(token);
+        if (row == Token_Set::npos) return;
+        size_t last = tokens.size();
+        if (row != last) std::apply([&](auto*... column) { ((column[row] = column[last]), ...); }, columns);
+        this->left(token);
+    }
+    void erase(std::span<const size_t> itokens) { for (size_t token : itokens) erase(token); }
+
+    // Gives each `to` token a copy of `from`'s value, if it has one.
+    void clone(size_t from, std::span<const size_t> to) { if (std::optional<T> value = find(from)) assign(to, *value); }
+
+    // Gives each token the value at the same position, growing every field once.
+    void assign(std::span<const size_t> itokens, std::span<const T> values) {
+        assert(itokens.size() == values.size() && "Soa_Datum::assign needs one value per token.");
+        grow_for(itokens);
+        for (size_t i = 0; i < itokens.size(); ++i) if (itokens[i]) scatter(tokens.index(itokens[i]), values[i]);
+    }
+    // Gives every token the same value.
+    void assign(std::span<const size_t> itokens, const T& value) {
+        grow_for(itokens);
+        for (size_t token : itokens) if (token) scatter(tokens.index(token), value);
+    }
+
+    // Makes room for `n` rows without moving the fields again.
+    void reserve(size_t n) { if (n > capacity) grow(n); }
+
+    // The I-th field of every row, 64-byte aligned.
+    template<size_t I> std::span<type<I>> field() { return std::span<type<I>>(std::get<I>(columns), size()); }
+
+    // Reorders the rows into ascending token order.
+    void sort() {
+        if (tokens.sorted) return;
+        std::vector<size_t> order(tokens.size());
+        for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+        std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return Token_Set::slot(tokens.dense[a]) < Token_Set::slot(tokens.dense[b]); });
+        std::apply([&](auto*... column) { (permute(column, order), ...); }, columns);
+        tokens.sort();
+    }
+
+    // Reorders the datum so that its first `order.size()` rows belong to the given
+    // tokens, in that order, and returns each field's matching column.
+    // Tokens without a value get a default one, as with `operator []`.
+    // Usage: `auto [x, y, z] = Position.align(tokens);`
+    auto align(std::span<const size_t> order) {
+        for (size_t i = 0; i < order.size(); ++i) {
+            size_t j = tokens.index(order[i]);
+            if (j == Token_Set::npos) j = insert(order[i]);
+            if (j == i) continue;
+            tokens.swap_positions(i, j);
+            std::apply([&](auto*... column) { (std::swap(column[i], column[j]), ...); }, columns);
+        }
+        return std::apply([&](auto*... column) { return std::make_tuple(std::span(column, order.size())...); }, columns);
+    }
+
+    size_t size() const { return tokens.size(); }
+
+private:
+    T gather(size_t row) const {
+        T value{};
+        gather(value, row, std::index_sequence_for<decltype(Fields)...>{});
+        return value;
+    }
+    template<size_t... Is> void gather(T& value, size_t row, std::index_sequence<Is...>) const { ((value.*Fields = std::get<Is>(columns)[row]), ...); }
+    void scatter(size_t row, const T& value) { scatter(row, value, std::index_sequence_for<decltype(Fields)...>{}); }
+    template<size_t... Is> void scatter(size_t row, const T& value, std::index_sequence<Is...>) { ((std::get<Is>(columns)[row] = value.*Fields), ...); }
+
+    // Adds the tokens that are new, with default values, growing every field once.
+    void grow_for(std::span<const size_t> itokens) {
+        size_t before = tokens.size();
+        tokens.insert(itokens);
+        reserve(tokens.size());
+        for (size_t row = before; row < tokens.size(); ++row) { scatter(row, T()); this->joined(tokens.dense[row]); }
+    }
+
+    // Moves every field to a larger block, at least doubling so appends stay amortized O(1).
+    void grow(size_t n) {
+        size_t next = std::max<size_t>({ n, capacity * 2, 16 });
+        size_t used = std::min(tokens.size(), capacity);
+        std::apply([&](auto*&... column) { ((column = move_to(column, used, next)), ...); }, columns);
+        capacity = next;
+    }
+    template<class F> F* move_to(F* column, size_t used, size_t next) {
+        F* moved = static_cast<F*>(resource->allocate(next * sizeof(F), alignment));
+        if (used) std::memcpy(moved, column, used * sizeof(F));
+        release(column, capacity);
+        return moved;
+    }
+    template<class F> void release(F* column, size_t count) { if (column) resource->deallocate(column, count * sizeof(F), alignment); }
+    template<class F> static void permute(F* column, const std::vector<size_t>& order) {
+        std::vector<F> sorted(order.size());
+        for (size_t i = 0; i < order.size(); ++i) sorted[i] = column[order[i]];
+        std::copy(sorted.begin(), sorted.end(), column);
+    }
+};
+#pragma endregion
+
+#pragma region Kernels
+// -----------------------------------------------------------------------------
+// Kernels: Element-wise float loops for Soa_Datum fields and Batch_Behavior columns.
+// Each kernel steps eight floats at a time with AVX2 when the compiler targets it
+// (/arch:AVX2, -mavx2), then four at a time with SSE2 (every x86-64) or NEON (ARM64),
+// and finishes the tail with a plain loop, which is all other targets get. Spans must have the same length and need not be aligned, though
+// Soa_Datum fields always are.
+// Example: `kernel::axpy(x, vx, dt);` // x[i] += vx[i] * dt
+// -----------------------------------------------------------------------------
+namespace kernel {
+    // y[i] += a * x[i]
+    inline void axpy(std::span<float> y, std::span<const float> x, float a) {
+        assert(y.size() == x.size() && "Kernel spans must have the same length.");
+        size_t i = 0;
+#if defined(__AVX2__)
+        __m256 va = _mm256_set1_ps(a);
+        for (; i + 8 <= y.size(); i += 8) _mm256_storeu_ps(&y[i], _mm256_add_ps(_mm256_loadu_ps(&y[i]), _mm256_mul_ps(va, _mm256_loadu_ps(&x[i]))));
+#endif
+#if defined(__SSE2__) || defined(_M_X64)
+        __m128 wa = _mm_set1_ps(a);
+        for (; i + 4 <= y.size(); i += 4) _mm_storeu_ps(&y[i], _mm_add_ps(_mm_loadu_ps(&y[i]), _mm_mul_ps(wa, _mm_loadu_ps(&x[i]))));
+#elif defined(__ARM_NEON)
+        for (; i + 4 <= y.size(); i += 4) vst1q_f32(&y[i], vmlaq_n_f32(vld1q_f32(&y[i]), vld1q_f32(&x[i]), a));
+#endif
+        for (; i < y.size(); ++i) y[i] += a * x[i];
+    }
+
+    // y[i] += x[i]
+    inline void add(std::span<float> y, std::span<const float> x) {
+        assert(y.size() == x.size() && "Kernel spans must have the same length.");
+        size_t i = 0;
+#if defined(__AVX2__)
+        for (; i + 8 <= y.size(); i += 8) _mm256_storeu_ps(&y[i], _mm256_add_ps(_mm256_loadu_ps(&y[i]), _mm256_loadu_ps(&x[i])));
+#endif
+#if defined(__SSE2__) || defined(_M_X64)
+        for (; i + 4 <= y.size(); i += 4) _mm_storeu_ps(&y[i], _mm_add_ps(_mm_loadu_ps(&y[i]), _mm_loadu_ps(&x[i])));
+#elif defined(__ARM_NEON)
+        for (; i + 4 <= y.size(); i += 4) vst1q_f32(&y[i], vaddq_f32(vld1q_f32(&y[i]), vld1q_f32(&x[i])));
+#endif
+        for (; i < y.size(); ++i) y[i] += x[i];
+    }
+
+    // y[i] *= a
+    inline void scale(std::span<float> y, float a) {
+        size_t i = 0;
+#if defined(__AVX2__)
+        __m256 va = _mm256_set1_ps(a);
+        for (; i + 8 <= y.size(); i += 8) _mm256_storeu_ps(&y[i], _mm256_mul_ps(_mm256_loadu_ps(&y[i]), va));
+#endif
+#if defined(__SSE2__) || defined(_M_X64)
+        __m128 wa = _mm_set1_ps(a);
+        for (; i + 4 <= y.size(); i += 4) _mm_storeu_ps(&y[i], _mm_mul_ps(_mm_loadu_ps(&y[i]), wa));
+#elif defined(__ARM_NEON)
+        for (; i + 4 <= y.size(); i += 4) vst1q_f32(&y[i], vmulq_n_f32(vld1q_f32(&y[i]), a));
+#endif
+        for (; i < y.size(); ++i) y[i] *= a;
+    }
+}
+#pragma endregion
 
--------------------------------
-Ideology & Motivation
--------------------------------
-- **Token**: A nominal type representing a pure identity, containing no data or behavior by default.
-- **Datum**: A data container that holds values but has no identity or behavior of its own.
-- **Behavior**: An executable unit of logic that has no identity or data storage.
+#pragma region Threading
+// -----------------------------------------------------------------------------
+// Thread_Pool: A fixed set of worker threads for fork-join loops.
+// `parallel_for` splits the index space into one range per thread. Each thread
+// claims chunks from its own range first and then steals chunks from the others.
+// The calling thread takes part as well, so nested calls from workers cannot deadlock.
+// Workers hold lane IDs for as long as their pool lives; a destroyed pool gives them
+// back, so creating and destroying pools keeps reusing the same low lanes.
+// -----------------------------------------------------------------------------
+struct Thread_Pool {
+    // The calling thread's lane: 0 outside of any pool, otherwise an ID no other live worker holds.
+    static size_t& lane() { static thread_local size_t id = 0; return id; }
+    // One past the highest lane handed out so far, which bounds every lane-indexed table.
+    static std::atomic<size_t>& lanes() { static std::atomic<size_t> count = 1; return count; }
+    // Takes the lowest lane ID nobody holds, and gives one back.
+    static size_t claim() {
+        Free_Lanes& spare = free_lanes();
+        std::lock_guard lock(spare.mutex);
+        if (spare.ids.empty()) return lanes()++;
+        std::pop_heap(spare.ids.begin(), spare.ids.end(), std::greater<>());
+        size_t id = spare.ids.back();
+        spare.ids.pop_back();
+        return id;
+    }
+    static void release(size_t id) {
+        Free_Lanes& spare = free_lanes();
+        std::lock_guard lock(spare.mutex);
+        spare.ids.push_back(id);
+        std::push_heap(spare.ids.begin(), spare.ids.end(), std::greater<>());
+    }
+    // How many parallel_for calls the calling thread is running chunks of. While it is
+    // nonzero, other threads may be working on the same containers.
+    static size_t& depth() { static thread_local size_t count = 0; return count; }
 
-This separation of concerns allows for a highly flexible and dynamic system where:
-- Data and behaviors can be associated with tokens at runtime.
-- Objects can be composed with desired characteristics without relying on traditional inheritance, avoiding rigid class hierarchies.
-- Data and behaviors can be shared and reused across multiple tokens or groups of tokens.
+    Thread_Pool(size_t threads = std::max<size_t>(1, std::thread::hardware_concurrency()) - 1) {
+        for (size_t i = 0; i < threads; ++i) {
+            size_t id = claim();
+            ids.push_back(id);
+            workers.emplace_back([this, id] { work(id); });
+        }
+    }
+    ~Thread_Pool() {
+        { std::lock_guard lock(mutex); stop = true; }
+        wake.notify_all();
+        for (auto& worker : workers) worker.join();
+        for (size_t id : ids) release(id);
+    }
+    Thread_Pool(const Thread_Pool&) = delete;
+    Thread_Pool& operator = (const Thread_Pool&) = delete;
 
--------------------------------
-Usage Overview
--------------------------------
-The pattern is designed to be intuitive and expressive.
+    // The number of threads that take part in a parallel_for, including the caller.
+    size_t size() const { return workers.size() + 1; }
 
-1.  **Create a Token**:
-    `Token myToken;`
+    // Calls `f(begin, end)` on disjoint chunks of at most `grain` indices covering [0, count).
+    template<class F> void parallel_for(size_t count, size_t grain, F&& f) {
+        if (!count) return;
+        if (!grain) grain = 1;
+        if (workers.empty() || count <= grain) { Inside inside; f(size_t(0), count); return; }
 
-2.  **Define a Datum** to hold a specific type of data:
-    `Datum<std::string> Name;`
+        Job job;
+        job.grain = grain;
+        job.count = std::min(size(), (count + grain - 1) / grain);
+        job.ranges = std::make_unique<Job::Range[]>(job.count);
+        for (size_t i = 0; i < job.count; ++i) {
+            job.ranges[i].next = count * i / job.count;
+            job.ranges[i].end = count * (i + 1) / job.count;
+        }
+        job.context = &f;
+        job.run = [](void* context, size_t begin, size_t end) { (*static_cast<std::remove_reference_t<F>*>(context))(begin, end); };
 
-3.  **Associate Data with a Token**:
-    `myToken + Name = "John Doe";`
+        { std::lock_guard lock(mutex); jobs.push_back(&job); }
+        wake.notify_all();
+        { Inside inside; job.execute(0); }
+        { std::lock_guard lock(mutex); jobs.erase(std::find(jobs.begin(), jobs.end(), &job)); }
+        while (job.users.load(std::memory_order_acquire)) std::this_thread::yield();
+    }
 
-4.  **Define a Behavior** to encapsulate logic:
-    `Behavior<void()> Greet = { [&](){ std::cout << "Hello, " << Greet[Name] << std::endl; } };`
+private:
+    // Lane IDs given back by destroyed pools, as a min-heap.
+    struct Free_Lanes {
+        std::mutex mutex;
+        std::vector<size_t> ids;
+    };
+    // Never destroyed, so pools that outlive static destruction can still give their lanes back.
+    static Free_Lanes& free_lanes() { static Free_Lanes* spare = new Free_Lanes; return *spare; }
 
-5.  **Subscribe a Token to a Behavior**:
-    `myToken += Greet;`
+    // Marks the calling thread as running chunks for as long as it lives.
+    struct Inside {
+        Inside() { ++depth(); }
+        ~Inside() { --depth(); }
+    };
 
-6.  **Execute a Behavior**:
-    `myToken[Greet]();` // Executes for one token
-    `Greet();`          // Executes for all subscribed tokens
+    struct Job {
+        struct alignas(64) Range {
+            std::atomic<size_t> next = 0; // The next unclaimed index.
+            size_t end = 0;
+        };
+        std::unique_ptr<Range[]> ranges;
+        size_t count = 0;                       // The number of ranges.
+        size_t grain = 1;
+        void* context = nullptr;
+        void (*run)(void*, size_t, size_t) = nullptr;
+        std::atomic<size_t> users = 0;          // Workers currently executing chunks of this job.
 
-================================================================================
-*/
+        bool exhausted() const {
+            for (size_t i = 0; i < count; ++i)
+                if (ranges[i].next.load(std::memory_order_relaxed) < ranges[i].end) return false;
+            return true;
+        }
 
-#pragma region Declarations
-// Forward declarations for all core components of the pattern.
-struct Token;
-template<class t> struct Datum;
-template<class t> struct Static_Datum;
-template<class t> struct Solitary_Datum;
-template<class t> struct Shared_Datum;
-template<class R, class... Args> struct Behavior;
-#pragma endregion
+        // Claims chunks from the home range, then steals from the others in turn.
+        void execute(size_t home) {
+            for (size_t k = 0; k < count; ++k) {
+                Range& range = ranges[(home + k) % count];
+                while (true) {
+                    size_t begin = range.next.fetch_add(grain, std::memory_order_relaxed);
+                    if (begin >= range.end) break;
+                    run(context, begin, std::min(begin + grain, range.end));
+                }
+            }
+        }
+    };
+
+    void work(size_t id) {
+        lane() = id;
+        std::unique_lock lock(mutex);
+        while (true) {
+            Job* job = nullptr;
+            wake.wait(lock, [&] {
+                for (Job* j : jobs) if (!j->exhausted()) { job = j; return true; }
+                return stop;
+            });
+            if (!job) return;
+            job->users.fetch_add(1, std::memory_order_relaxed);
+            lock.unlock();
+            { Inside inside; job->execute(id); }
+            job->users.fetch_sub(1, std::memory_order_release);
+            lock.lock();
+        }
+    }
+
+    std::vector<std::thread> workers;
+    std::vector<size_t> ids; // The workers' lanes, returned when the pool is destroyed.
+    std::vector<Job*> jobs;  // Running jobs that still accept workers.
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stop = false;
+};
 
-#pragma region Datums
 // -----------------------------------------------------------------------------
-// Datum: Associates a unique data value with each token.
-// This is the most common type of datum.
+// Access: The datums a behavior declares that it reads and writes.
+// Two behaviors conflict when one writes a datum the other reads or writes.
+// Writes to datums whose value is shared by many tokens are flagged separately,
+// since a parallel broadcast would race on that single value.
 // -----------------------------------------------------------------------------
-template<class T>
-struct Datum {
-    std::unordered_map<size_t, T> data;
+struct Access {
+    std::vector<const void*> reads;
+    std::vector<const void*> writes;
+    bool shared_writes = false; // Writes a Static_Datum, Solitary_Datum or Shared_Datum.
 
-    // Accesses (or creates) the data associated with a specific token ID.
-    T& operator [] (const size_t& token) {
-        static T invalid; // Return a static invalid instance if token is 0.
-        if (!token) return invalid;
-        return data[token];
+    bool conflicts(const Access& other) const {
+        auto overlaps = [](const std::vector<const void*>& a, const std::vector<const void*>& b) {
+            for (const void* x : a) if (std::find(b.begin(), b.end(), x) != b.end()) return true;
+            return false;
+        };
+        return overlaps(writes, other.writes) || overlaps(writes, other.reads) || overlaps(reads, other.writes);
     }
 };
 
+// True for datums that hand the same value to several tokens.
+template<class D> constexpr bool shares_values = false;
+template<class T> constexpr bool shares_values<Static_Datum<T>> = true;
+template<class T> constexpr bool shares_values<Solitary_Datum<T>> = true;
+template<class T> constexpr bool shares_values<Shared_Datum<T>> = true;
+#pragma endregion
+
+#pragma region Behavior
 // -----------------------------------------------------------------------------
-// Static_Datum: Shares a single data instance among a subscribed set of tokens.
-// Useful for properties that are constant across a group.
+// Callable_Signature: Recovers `R(Args...)` from a lambda, functor or function pointer.
 // -----------------------------------------------------------------------------
-template<class T>
-struct Static_Datum {
-    T data;
-    std::unordered_set<size_t> tokens;
+template<class F> struct Callable_Signature : Callable_Signature<decltype(&F::operator())> {};
+template<class R, class... Args> struct Callable_Signature<R(*)(Args...)> { using type = R(Args...); };
+template<class C, class R, class... Args> struct Callable_Signature<R(C::*)(Args...)> { using type = R(Args...); };
+template<class C, class R, class... Args> struct Callable_Signature<R(C::*)(Args...) const> { using type = R(Args...); };
+
+// -----------------------------------------------------------------------------
+// Subscriptions: The subscriber set shared by Behavior, Batch_Behavior and
+// Async_Behavior, with the container side of membership and the partitions that
+// broadcasts walk. A derived behavior that needs more work per unsubscription
+// provides its own `erase(size_t)`; the span form and `clone` go through it.
+// -----------------------------------------------------------------------------
+template<class Derived>
+struct Subscriptions : Registered<Derived> {
+    static constexpr bool tracks_members = true;
 
-    Static_Datum(const T& idata) : data(idata) {}
+    Token_Set tokens; // Container for the subscribed token IDs.
 
-    // Accesses the shared data if the token is in the subscribed set.
-    T& operator [] (size_t token) {
-        static T invalid;
-        if (!tokens.contains(token)) return invalid;
-        return data;
+    Subscriptions(std::pmr::memory_resource* resource) : tokens(resource) {}
+
+    // Subscribes one or several tokens.
+    void insert(size_t token) {
+        if (!token) return;
+        tokens.insert(token);
+        this->joined(token);
     }
+    void insert(std::span<const size_t> itokens) {
+        tokens.insert(itokens);
+        for (size_t token : itokens) if (token) this->joined(token);
+    }
+    // Unsubscribes one or several tokens.
+    void erase(size_t token) { if (tokens.erase(token) != Token_Set::npos) this->left(token); }
+    void erase(std::span<const size_t> itokens) { for (size_t token : itokens) derived().erase(token); }
+    bool contains(size_t token) const { return tokens.contains(token); }
+    // Subscribes the `to` tokens if `from` is subscribed.
+    void clone(size_t from, std::span<const size_t> to) { if (contains(from)) derived().insert(to); }
+    // Reserves room for `n` subscribers, so a burst of subscriptions does not reallocate.
+    void reserve(size_t n) { tokens.reserve(n); }
 
-    // Allows direct access to the underlying data.
-    operator T& () { return data; }
+    // Splits the subscribers into `count` partitions (awake and asleep, enabled and
+    // disabled, or any tags), all starting in partition 0. Broadcasts visit partition 0 only.
+    Derived& partition(size_t count) { tokens.partition(count); return derived(); }
+    // Moves a subscriber to another partition. Returns false if the token is not subscribed.
+    bool move(size_t token, size_t to) {
+        assert(to < tokens.partitions() && "Partition out of range; call `partition` first.");
+        return tokens.move(token, to);
+    }
+    // Takes a subscriber out of broadcasts, and brings it back, without unsubscribing it.
+    // A behavior without partitions gets two on the first `sleep`.
+    void sleep(size_t token) { if (tokens.partitions() < 2) tokens.partition(2); tokens.move(token, 1); }
+    void wake(size_t token) { tokens.move(token, 0); }
+    bool awake(size_t token) const { return tokens.partition_of(token) == 0; }
+
+protected:
+    Derived& derived() { return static_cast<Derived&>(*this); }
 };
 
 // -----------------------------------------------------------------------------
-// Solitary_Datum: A data instance that can only be associated with a single token.
+// Behavior_Context: The per-thread "current token" of a behavior that runs once per
+// token, the datum access made through it, and the datums it declares it touches.
+// Outside of a pool the context is `ct`; each pool lane has its own, so a broadcast
+// across a Thread_Pool gives every thread its own current token. Call `fit_lanes`
+// before handing the behavior to a pool.
 // -----------------------------------------------------------------------------
-template<class T>
-struct Solitary_Datum {
-    T data;
-    size_t token = 0; // The ID of the single associated token.
+template<class Derived>
+struct Behavior_Context {
+    struct alignas(64) Lane { size_t token = 0; };
 
-    Solitary_Datum(const T& idata) : data(idata) {}
+    size_t ct = 0;           // The "current token" context for execution outside of a pool.
+    std::vector<Lane> lanes; // The "current token" contexts of pool threads, indexed by lane - 1.
+    Access access;           // The datums this behavior declares it reads and writes.
 
-    // Accesses the data only if the requesting token's ID matches the stored one.
-    T& operator [] (size_t itoken) {
-        static T invalid;
-        if (itoken != token) return invalid;
-        return data;
+    // Returns the calling thread's "current token" context.
+    size_t& context() {
+        size_t lane = Thread_Pool::lane();
+        if (lane && lane <= lanes.size()) return lanes[lane - 1].token;
+        return ct;
+    }
+    // Gives every lane handed out so far a context of its own.
+    void fit_lanes() {
+        size_t count = Thread_Pool::lanes().load();
+        if (lanes.size() < count) lanes.resize(count);
     }
-    void operator = (T& idata) { data = idata; }
-};
 
-// -----------------------------------------------------------------------------
-// Shared_Datum: Allows distinct groups of tokens to share data instances.
-// Tokens are mapped to a "pool" of data.
-// -----------------------------------------------------------------------------
-template<class T>
-struct Shared_Datum {
-    std::unordered_map<size_t, size_t> pools; // Maps a token ID to a data pool ID.
-    std::unordered_map<size_t, T> data;       // Stores the data for each pool.
-    size_t count = 0;
+    // Allows the behavior to be used where a token ID is expected, providing the current context.
+    // Example: `MyDatum[myBehavior]`
+    operator size_t& () { return context(); }
 
-    // Accesses the data from the pool associated with the given token.
-    T& operator [] (size_t& token) {
-        static T invalid;
-        if (!pools.contains(token)) return invalid;
-        return data[pools[token]];
+#pragma region Datum Access
+    // Allows a behavior to access a datum using the current token's context.
+    // Example: `myBehavior[MyDatum]` will access `MyDatum` for the current token.
+    // Access to a missing entry creates it, which must not happen while other threads
+    // use the datum; inside a Thread_Pool job, debug builds assert that the entry exists.
+    // A const Shared_Datum is read without being logged: `Heal[std::as_const(Regen)]`.
+    template<class T> T& operator [] (Datum<T>& datum) { return datum[existing(datum)]; }
+    template<class T> T& operator [] (Dense_Datum<T>& datum) { return datum[existing(datum)]; }
+    template<class T> T& operator [] (Paged_Datum<T>& datum) { return datum[existing(datum)]; }
+    template<class T> T& operator [] (Static_Datum<T>& datum) { return datum[context()]; }
+    template<class T> T& operator [] (Solitary_Datum<T>& datum) { return datum[context()]; }
+    template<class T> T& operator [] (Shared_Datum<T>& datum) { return datum[context()]; }
+    template<class T> const T& operator [] (const Shared_Datum<T>& datum) { return datum[context()]; }
+    template<class T> typename Concurrent_Datum<T>::Entry operator [] (Concurrent_Datum<T>& datum) { return datum[context()]; }
+    template<class T, size_t N> T& operator [] (Buffered_Datum<T, N>& datum) { return datum[existing(datum)]; }
+    template<class T, class A, size_t I> T& operator [] (Archetype_Column<T, A, I>& column) { return column[context()]; }
+    template<class T, auto... Fs> typename Soa_Datum<T, Fs...>::Row operator [] (Soa_Datum<T, Fs...>& datum) { return datum[existing(datum)]; }
+
+    // The current token, for an access that would create a missing entry.
+    template<class D> size_t& existing(D& datum) {
+        size_t& token = context();
+        assert((!Thread_Pool::depth() || !token || datum.contains(token)) && "A behavior running on a Thread_Pool must not create datum entries; give the token one beforehand.");
+        return token;
     }
-};
 #pragma endregion
 
-#pragma region Behavior
+#pragma region Access
+    // Declares datums this behavior only reads. Usage: `Move.reads(Velocity).writes(Position);`
+    template<class... Ds> Derived& reads(Ds&... datums) {
+        (access.reads.push_back(&datums), ...);
+        return static_cast<Derived&>(*this);
+    }
+    // Declares datums this behavior writes.
+    template<class... Ds> Derived& writes(Ds&... datums) {
+        (access.writes.push_back(&datums), ...);
+        access.shared_writes = access.shared_writes || (shares_values<Ds> || ...);
+        return static_cast<Derived&>(*this);
+    }
+#pragma endregion
+};
+
 // -----------------------------------------------------------------------------
 // Behavior: Encapsulates executable logic that can be subscribed to by tokens.
 // The behavior's logic is executed within the "context" of a specific token.
+// Each thread has its own context, so `parallel` can broadcast across a Thread_Pool.
+//
+// `Fn` is the stored callable. It defaults to std::function, which allows the usual
+// self-referencing form `Behavior<void()> Greet = { [&]() { ... Greet[Name] ... } };`.
+// Storing the lambda's own type instead lets broadcasts inline it:
+//     Behavior Tick = [&]() { ... };                                      // deduced from the lambda
+//     auto Greet = make_behavior<void()>([&](auto& self) { ... self[Name] ... });
+// A callable whose first parameter accepts the Behavior receives it, which is how
+// a behavior with a deduced type reaches its own datum context.
 // -----------------------------------------------------------------------------
-template<class R, class... Args>
-struct Behavior<R(Args...)> {
+template<class R, class Fn, class... Args>
+struct Behavior<R(Args...), Fn> : Subscriptions<Behavior<R(Args...), Fn>>, Behavior_Context<Behavior<R(Args...), Fn>> {
+    using Subscriptions<Behavior>::tokens;
+    using Subscriptions<Behavior>::awake;
+    using Behavior_Context<Behavior>::access;
+    using Behavior_Context<Behavior>::context;
+    using Behavior_Context<Behavior>::operator [];
 #pragma region properties
-    std::unordered_set<size_t> tokens;      // Container for the subscribed token IDs.
-    std::function<R(Args...)> behavior;     // The actual functor to be executed.
-    size_t ct = 0;                          // The "current token" context for execution.
+    // A callable handle to the behavior for one token, returned by `behavior[token]`.
+    // Calling it for a token that is not subscribed throws std::bad_function_call.
+    struct Invoker {
+        Behavior* behavior; // Null if the token is not subscribed.
+        size_t token;
+
+        R operator () (Args... args) const {
+            if (!behavior) throw std::bad_function_call();
+            [[maybe_unused]] auto scope = behavior->stats.scope(1);
+            behavior->context() = token;
+            return behavior->invoke(args...);
+        }
+        explicit operator bool () const { return behavior != nullptr; }
+    };
+
+    // A change log the behavior reacts to, and the last version it has handled.
+    struct Watch { Change_Log* log; Change_Log::Cursor seen; };
+
+    Fn behavior;                            // The actual functor to be executed.
+    size_t grain = 64;                      // Tokens claimed at a time by a thread during `parallel`.
+    std::vector<Watch> watches;             // The change logs `react` draws its tokens from.
+    std::vector<size_t> pending;            // Scratch space for `react`, kept to avoid reallocating.
+    Behavior_Stats stats;                   // Call counts and timings, when NOMINAL_PROFILE is on.
 #pragma endregion
 
 #pragma region Core
-    Behavior(std::function<R(Args...)> ibehavior) : behavior(ibehavior) {}
+    Behavior(Fn ibehavior, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : Subscriptions<Behavior>(resource), behavior(std::move(ibehavior)) {}
+
+    // Returns a handle that runs the behavior in the context of a specific token.
+    Invoker operator [] (const size_t& token) {
+        return { tokens.contains(token) ? this : nullptr, token };
+    }
 
-    // Sets the execution context to a specific token and returns the behavior's function.
-    std::function<R(Args...)>& operator [] (const size_t& token) {
-        static std::function<R(Args...)> invalid;
-        if (!tokens.contains(token)) return invalid;
-        ct = token;
-        return behavior;
+    // Calls the functor in the current context, passing the behavior first if it takes it.
+    R invoke(Args... args) {
+        if constexpr (std::is_invocable_v<Fn&, Behavior&, Args...>) return behavior(*this, args...);
+        else return behavior(args...);
     }
 #pragma endregion
 
-#pragma region Datum Access
-    // Allows a behavior to access a datum using the current token's context.
-    // Example: `myBehavior[MyDatum]` will access `MyDatum` for the current token.
-    template<class T> T& operator [] (Datum<T>& datum) { return datum[ct]; }
-    template<class T> T& operator [] (Static_Datum<T>& datum) { return datum[ct]; }
-    template<class T> T& operator [] (Solitary_Datum<T>& datum) { return datum[ct]; }
-    template<class T> T& operator [] (Shared_Datum<T>& datum) { return datum[ct]; }
+#pragma region Access
+    // Binds the behavior to datums, turning on their change tracking, so that `react`
+    // runs it for tokens whose values change from now on. A Shared_Datum reports
+    // tokens joining, moving between and leaving pools, not writes to pool values.
+    // Usage: `Validate.watch(Health, Armor);`
+    template<class... Ds> Behavior& watch(Ds&... datums) {
+        ((datums.track(), watches.push_back({ &datums.log, datums.log.follow() })), ...);
+        return *this;
+    }
 #pragma endregion
 
 #pragma region QOL
-    // Executes the behavior for every subscribed token.
-    void operator () (Args... args) {
-        for (auto& token : tokens) {
-            ct = token;
-            behavior(args...);
+    // Executes the behavior for every subscribed token, in ascending token order.
+    // With partitions, only the tokens in partition 0 run.
+    void operator () (Args... args) { run(0, args...); }
+
+    // Executes the behavior for every token of one partition, in ascending token order.
+    // The walk covers that partition's contiguous range of `tokens` and nothing else.
+    void run(size_t partition, Args... args) {
+        tokens.sort(partition);
+        std::span<const size_t> members = tokens.members(partition);
+        [[maybe_unused]] auto scope = stats.scope(members.size());
+        size_t& current = context();
+        for (size_t i = 0; i < members.size(); ++i) {
+            current = members[i];
+            invoke(args...);
         }
     }
 
-    // Allows the behavior to be used where a token ID is expected, providing the current context.
-    // Example: `MyDatum[myBehavior]`
-    operator size_t& () { return ct; }
+    // Executes the behavior once for every awake token whose watched data was added,
+    // changed or removed since the last call, in ascending token order, and returns how
+    // many tokens that was. Call it at a sync point; changes are coalesced, so a token
+    // written many times runs once. Changes the behavior itself makes while reacting do not
+    // trigger it again.
+    size_t react(Args... args) {
+        pending.clear();
+        for (Watch& watch : watches) {
+            watch.log->since(*watch.seen, [&](size_t token, Change_Log::Kind) { if (awake(token)) pending.push_back(token); });
+        }
+        std::sort(pending.begin(), pending.end(), [](size_t a, size_t b) { return Token_Set::slot(a) < Token_Set::slot(b); });
+        pending.erase(std::unique(pending.begin(), pending.end()), pending.end());
+        [[maybe_unused]] auto scope = stats.scope(pending.size());
+        size_t& current = context();
+        for (size_t token : pending) {
+            current = token;
+            invoke(args...);
+        }
+        for (Watch& watch : watches) watch.log->advance(watch.seen);
+        return pending.size();
+    }
+
+    // Executes the behavior for every token of partition 0, spread across the pool's threads.
+    // Every token must already have an entry in each datum it touches (debug builds assert
+    // it), and tokens must not join or leave containers or partitions during the broadcast;
+    // only per-token values may change. Deferred changes go through a Command_Buffer.
+    void parallel(Thread_Pool& pool, Args... args) {
+        assert(!access.shared_writes && "A parallel Behavior must not write datums shared between tokens.");
+        tokens.sort(0);
+        std::span<const size_t> members = tokens.members(0);
+        [[maybe_unused]] auto scope = stats.scope(members.size());
+        this->fit_lanes();
+        pool.parallel_for(members.size(), grain, [&](size_t begin, size_t end) {
+            size_t& current = context();
+            for (size_t i = begin; i < end; ++i) {
+                current = members[i];
+                invoke(args...);
+            }
+        });
+    }
+#pragma endregion
+};
+
+// Deduces the signature and callable type from a lambda or function pointer.
+template<class F> Behavior(F) -> Behavior<typename Callable_Signature<F>::type, F>;
+
+// Builds a Behavior that stores the callable's own type, for callables such as
+// generic lambdas whose signature cannot be deduced.
+template<class Signature, class F> Behavior<Signature, F> make_behavior(F ibehavior) { return Behavior<Signature, F>(std::move(ibehavior)); }
+
+// -----------------------------------------------------------------------------
+// Batch_Behavior: A Behavior that runs once per broadcast for all subscribed tokens.
+// The functor receives the subscribed token IDs as a span, and `batch[dense_datum]`
+// returns the matching column of values (index i belongs to token i), so the work
+// is a plain loop over contiguous arrays instead of one call per token.
+// Example:
+//     Batch_Behavior<void(float)> Move = { [&](std::span<const size_t> tokens, float dt) {
+//         auto pos = Move[Position]; auto vel = Move[Velocity];
+//         for (size_t i = 0; i < tokens.size(); ++i) pos[i] += vel[i] * dt;
+//     } };
+// -----------------------------------------------------------------------------
+template<class R, class... Args>
+struct Batch_Behavior<R(Args...)> : Subscriptions<Batch_Behavior<R(Args...)>> {
+    using Subscriptions<Batch_Behavior>::tokens;
+#pragma region properties
+    std::function<R(std::span<const size_t>, Args...)> behavior;    // The functor run over the whole batch.
+    size_t current = 0;                                             // The partition of the latest batch.
+    Behavior_Stats stats;                                           // Call counts and timings, when NOMINAL_PROFILE is on.
+#pragma endregion
+
+#pragma region Core
+    Batch_Behavior(std::function<R(std::span<const size_t>, Args...)> ibehavior, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : Subscriptions<Batch_Behavior>(resource), behavior(ibehavior) {}
+
+    // Executes the behavior once for every subscribed token, in ascending token order.
+    // With partitions, the batch is partition 0.
+    R operator () (Args... args) { return run(0, args...); }
+    // Executes the behavior once for the tokens of one partition, in ascending token order.
+    R run(size_t partition, Args... args) {
+        tokens.sort(partition);
+        current = partition;
+        std::span<const size_t> members = tokens.members(partition);
+        [[maybe_unused]] auto scope = stats.scope(members.size());
+        return behavior(members, args...);
+    }
+#pragma endregion
+
+#pragma region Datum Access
+    // Returns the datum's values for the latest batch, aligned with its token span.
+    // The column stays valid until the datum or the subscriptions change.
+    template<class T> std::span<T> operator [] (Dense_Datum<T>& datum) { return datum.align(tokens.members(current)); }
+    // A Soa_Datum yields one column per field. Usage: `auto [x, y, z] = Move[Position];`
+    template<class T, auto... Fs> auto operator [] (Soa_Datum<T, Fs...>& datum) { return datum.align(tokens.members(current)); }
 #pragma endregion
 };
 #pragma endregion
@@ -194,31 +2846,74 @@ struct Behavior<R(Args...)> {
 // It acts as a key to access associated data and behaviors.
 // -----------------------------------------------------------------------------
 struct Token {
-    size_t self; // The unique ID of this token.
+    size_t self;        // The unique ID of this token.
+    bool owner = false; // Whether destroying this Token destroys the ID.
 
 #pragma region Base
-    Token() {
-        static size_t count = 0;
-        self = ++count;
-    }
+    // A new token owns its ID; tokens made from an existing ID, and copies, are plain handles.
+    Token() : self(Token_Registry::global().create()), owner(true) {}
     Token(size_t& id) : self(id) {}
-    ~Token() {}
+    Token(const Token& other) : self(other.self) {}
+    Token(Token&& other) noexcept : self(other.self), owner(other.owner) { other.owner = false; }
+    Token& operator = (const Token& other) { if (this != &other) { release(); self = other.self; } return *this; }
+    Token& operator = (Token&& other) noexcept {
+        if (this != &other) { release(); self = other.self; owner = other.owner; other.owner = false; }
+        return *this;
+    }
+    ~Token() { release(); }
+
+    // True until the token's ID is destroyed.
+    bool alive() const { return Token_Registry::global().alive(self); }
+
+    // Removes the token from every Datum and Behavior and retires its ID.
+    void destroy() {
+        owner = false;
+        if (!alive()) return;
+        destroy(std::span<const size_t>(&self, 1));
+    }
+
+    // Removes several tokens from every Datum and Behavior in one pass per container,
+    // then retires their IDs.
+    static void destroy(std::span<const size_t> tokens) {
+        Container_Registry::global().erase(tokens);
+        for (size_t token : tokens) Token_Registry::global().destroy(token);
+    }
+
+    // Returns a new token with copies of this token's values and subscriptions.
+    // Shared_Datum members join the same pool.
+    Token clone() const {
+        Token copy;
+        clone(self, std::span<const size_t>(&copy.self, 1));
+        return copy;
+    }
+    // Copies a token onto many at once (prefab spawning): one bulk call per container it is in.
+    static void clone(size_t from, std::span<const size_t> to) { Container_Registry::global().clone(from, to); }
+
+    // Lists the token's values, one "name: value" line per container it is in.
+    std::string describe() const { return Container_Registry::global().describe(self); }
 #pragma endregion
 
 #pragma region Datum Access
     // Allows a token to directly access data within a datum.
     // Example: `myToken[MyDatum]`
     template<class T> T& operator [] (Datum<T>& idatum) { return idatum[self]; }
+    template<class T> T& operator [] (Dense_Datum<T>& idatum) { return idatum[self]; }
+    template<class T> T& operator [] (Paged_Datum<T>& idatum) { return idatum[self]; }
     template<class T> T& operator [] (Solitary_Datum<T>& idatum) { return idatum[self]; }
     template<class T> T& operator [] (Shared_Datum<T>& idatum) { return idatum[self]; }
+    template<class T> const T& operator [] (const Shared_Datum<T>& idatum) const { return idatum[self]; }
     template<class T> T& operator [] (Static_Datum<T>& idatum) { return idatum[self]; }
+    template<class T> typename Concurrent_Datum<T>::Entry operator [] (Concurrent_Datum<T>& idatum) { return idatum[self]; }
+    template<class T, size_t N> T& operator [] (Buffered_Datum<T, N>& idatum) { return idatum[self]; }
+    template<class T, class A, size_t I> T& operator [] (Archetype_Column<T, A, I>& column) { return column[self]; }
+    template<class T, auto... Fs> typename Soa_Datum<T, Fs...>::Row operator [] (Soa_Datum<T, Fs...>& idatum) { return idatum[self]; }
 #pragma endregion
 
 #pragma region Behavior Access
     // Allows a token to access a specific behavior's function.
     // Example: `myToken[myBehavior]()`
-    template<class R, class... Args>
-    std::function<R(Args...)> operator [] (Behavior<R(Args...)>& behavior) {
+    template<class R, class Fn, class... Args>
+    typename Behavior<R(Args...), Fn>::Invoker operator [] (Behavior<R(Args...), Fn>& behavior) {
         return behavior[self];
     }
 #pragma endregion
@@ -227,6 +2922,10 @@ struct Token {
     // Allows a token to be used wherever its ID (size_t) is needed.
     operator size_t& () { return self; }
 #pragma endregion
+
+private:
+    // Destroys the ID if this Token owns it.
+    void release() { if (owner) destroy(); }
 };
 #pragma endregion
 
@@ -235,33 +2934,468 @@ struct Token {
 
 #pragma region Datums
 // Associates a value with a token in a Datum. Usage: `token + datum = value;`
-template<class T> T& operator + (size_t& token, Datum<T>& datum) { return datum.data[token]; }
+template<class T> T& operator + (size_t& token, Datum<T>& datum) { return datum[token]; }
 // Removes a token's data from a Datum. Usage: `value = token - datum;`
-template <class T> T operator - (size_t& token, Datum<T>& datum) { T val = datum[token]; datum.data.erase(token); return val; }
+template <class T> T operator - (size_t& token, Datum<T>& datum) { T* value = datum.find(token); T val = value ? std::move(*value) : T(); datum.erase(token); return val; }
+
+// Associates a value with a token in a Dense_Datum. Usage: `token + dense_datum = value;`
+template<class T> T& operator + (size_t& token, Dense_Datum<T>& datum) { return datum.insert(token); }
+// Removes a token's data from a Dense_Datum. Usage: `value = token - dense_datum;`
+template <class T> T operator - (size_t& token, Dense_Datum<T>& datum) { T* value = datum.find(token); T val = value ? std::move(*value) : T(); datum.erase(token); return val; }
+
+// Associates a value with a token in a Paged_Datum. Usage: `token + paged_datum = value;`
+template<class T> T& operator + (size_t& token, Paged_Datum<T>& datum) { return datum.insert(token); }
+// Removes a token's data from a Paged_Datum. Usage: `value = token - paged_datum;`
+template <class T> T operator - (size_t& token, Paged_Datum<T>& datum) { T* value = datum.find(token); T val = value ? std::move(*value) : T(); datum.erase(token); return val; }
 
 // Subscribes a token to a Static_Datum. Usage: `token += static_datum;`
-template<class T> void operator += (size_t& token, Static_Datum<T>& datum) { datum.tokens.insert(token); }
+template<class T> void operator += (size_t& token, Static_Datum<T>& datum) { datum.insert(token); }
 // Unsubscribes a token from a Static_Datum. Usage: `token -= static_datum;`
-template <class T> void operator -= (size_t& token, Static_Datum<T>& datum) { datum.tokens.erase(token); }
+template <class T> void operator -= (size_t& token, Static_Datum<T>& datum) { datum.erase(token); }
+// Subscribes a range of tokens to a Static_Datum. Usage: `tokens += static_datum;`
+template<class T> void operator += (std::span<const size_t> tokens, Static_Datum<T>& datum) { datum.insert(tokens); }
+// Unsubscribes a range of tokens from a Static_Datum. Usage: `tokens -= static_datum;`
+template <class T> void operator -= (std::span<const size_t> tokens, Static_Datum<T>& datum) { datum.erase(tokens); }
 
 // Assigns a token to a Solitary_Datum. Usage: `token >> solitary_datum = value;`
 template <class T> T& operator >> (size_t& token, Solitary_Datum<T>& datum) { datum.token = token; return datum.data; }
 
 // Adds a token to a new data pool in a Shared_Datum. Usage: `token + shared_datum = value;`
-template<class T> T& operator + (size_t& token, Shared_Datum<T>& datum) { datum.pools[token] = ++datum.count; return datum[token]; }
-// Adds a token to the most recent data pool in a Shared_Datum. Usage: `token >> shared_datum;`
-template <class T> size_t& operator >> (size_t& token, Shared_Datum<T>& datum) { datum.pools[token] = datum.count; return datum.pools[token]; }
+template<class T> T& operator + (size_t& token, Shared_Datum<T>& datum) { size_t pool = datum.create(); datum.join(token, pool); return datum.data[pool - 1]; }
+// Adds a token to the most recent data pool in a Shared_Datum, and returns the pool ID. Usage: `token >> shared_datum;`
+template <class T> size_t operator >> (size_t& token, Shared_Datum<T>& datum) { size_t pool = datum.count ? datum.count : datum.create(); datum.join(token, pool); return pool; }
+// Adds a range of tokens to the most recent data pool in a Shared_Datum, and returns the pool ID. Usage: `tokens >> shared_datum;`
+template <class T> size_t operator >> (std::span<const size_t> tokens, Shared_Datum<T>& datum) { size_t pool = datum.count ? datum.count : datum.create(); datum.join(tokens, pool); return pool; }
 // Removes a token from a Shared_Datum. Usage: `value = token - shared_datum;`
-template<class T> T operator - (size_t& token, Shared_Datum<T>& datum) { T val = datum[token]; datum.pools.erase(token); return val; }
+template<class T> T operator - (size_t& token, Shared_Datum<T>& datum) { T val = std::as_const(datum)[token]; datum.leave(token); return val; }
+
+// Associates a value with a token in a Buffered_Datum's back copy. Usage: `token + buffered_datum = value;`
+template<class T, size_t N> T& operator + (size_t& token, Buffered_Datum<T, N>& datum) { return datum[token]; }
+// Removes a token's data from a Buffered_Datum's back copy. Usage: `value = token - buffered_datum;`
+template<class T, size_t N> T operator - (size_t& token, Buffered_Datum<T, N>& datum) { T* value = datum.find(token); T val = value ? std::move(*value) : T(); datum.erase(token); return val; }
+
+// Associates a value with a token in a Concurrent_Datum. Usage: `token + concurrent_datum = value;`
+template<class T> typename Concurrent_Datum<T>::Entry operator + (size_t& token, Concurrent_Datum<T>& datum) { return datum[token]; }
+// Removes a token's data from a Concurrent_Datum. Usage: `value = token - concurrent_datum;`
+template<class T> T operator - (size_t& token, Concurrent_Datum<T>& datum) { return datum.take(token); }
+
+// Adds a token to an Archetype with default values, and returns its row. Usage: `token + archetype;`
+template<class... Ts> size_t operator + (size_t& token, Archetype<Ts...>& archetype) { return archetype.insert(token); }
+// Removes a token and its values from an Archetype. Usage: `token - archetype;`
+template<class... Ts> void operator - (size_t& token, Archetype<Ts...>& archetype) { archetype.erase(token); }
+
+// Associates a token with a row of a Soa_Datum. Usage: `token + Position = value;`
+template<class T, auto... Fs> typename Soa_Datum<T, Fs...>::Row operator + (size_t& token, Soa_Datum<T, Fs...>& datum) { return datum[token]; }
+// Removes a token's row from a Soa_Datum and returns its value. Usage: `token - Position;`
+template<class T, auto... Fs> T operator - (size_t& token, Soa_Datum<T, Fs...>& datum) { T val = datum.find(token).value_or(T()); datum.erase(token); return val; }
 #pragma endregion
 
 #pragma region Behaviors
 // Subscribes a token to a Behavior. Usage: `token += behavior;`
-template<class R, class... Args> void operator += (size_t& token, Behavior<R(Args...)>& behavior) { behavior.tokens.insert(token); }
+template<class R, class Fn, class... Args> void operator += (size_t& token, Behavior<R(Args...), Fn>& behavior) { behavior.insert(token); }
 // Unsubscribes a token from a Behavior. Usage: `token -= behavior;`
-template<class R, class... Args> void operator -= (size_t& token, Behavior<R(Args...)>& behavior) { behavior.tokens.erase(token); }
+template<class R, class Fn, class... Args> void operator -= (size_t& token, Behavior<R(Args...), Fn>& behavior) { behavior.erase(token); }
+// Subscribes a range of tokens to a Behavior. Usage: `tokens += behavior;`
+template<class R, class Fn, class... Args> void operator += (std::span<const size_t> tokens, Behavior<R(Args...), Fn>& behavior) { behavior.insert(tokens); }
+// Unsubscribes a range of tokens from a Behavior. Usage: `tokens -= behavior;`
+template<class R, class Fn, class... Args> void operator -= (std::span<const size_t> tokens, Behavior<R(Args...), Fn>& behavior) { behavior.erase(tokens); }
+
+// Subscribes a token to a Batch_Behavior. Usage: `token += batch_behavior;`
+template<class R, class... Args> void operator += (size_t& token, Batch_Behavior<R(Args...)>& behavior) { behavior.insert(token); }
+// Unsubscribes a token from a Batch_Behavior. Usage: `token -= batch_behavior;`
+template<class R, class... Args> void operator -= (size_t& token, Batch_Behavior<R(Args...)>& behavior) { behavior.erase(token); }
+// Subscribes a range of tokens to a Batch_Behavior. Usage: `tokens += batch_behavior;`
+template<class R, class... Args> void operator += (std::span<const size_t> tokens, Batch_Behavior<R(Args...)>& behavior) { behavior.insert(tokens); }
+// Unsubscribes a range of tokens from a Batch_Behavior. Usage: `tokens -= batch_behavior;`
+template<class R, class... Args> void operator -= (std::span<const size_t> tokens, Batch_Behavior<R(Args...)>& behavior) { behavior.erase(tokens); }
+#pragma endregion
+
+#pragma endregion
+
+#pragma region Commands
+// -----------------------------------------------------------------------------
+// Command_Buffer: Defers structural changes made while containers are being walked.
+// Inside a broadcast, behaviors record subscriptions, assignments, erasures and token
+// destruction instead of making them, and `flush` applies everything at a sync point
+// in bulk: each container gets one call per kind of command, and Token_Set backed
+// containers get their tokens in ascending order, so they append sorted runs.
+// Every thread records into its own lane without locks: pool workers use their
+// Thread_Pool::lane, and any other thread claims a lane of its own on first use and
+// gives it back when it exits. `flush` must not overlap recording, and containers
+// must outlive the commands recorded against them. Recording from more than 4096
+// threads at once throws std::length_error.
+// A flush applies subscriptions and assignments, then partition moves, then erasures
+// and unsubscriptions, then destruction. Repeated assignments to one token keep the last one its thread recorded.
+// Example:
+//     Behavior<void()> Burn = { [&] { if ((Burn[Health] -= 1) <= 0) commands.destroy(Burn.context()); } };
+//     Burn.parallel(pool);
+//     commands.flush();
+// -----------------------------------------------------------------------------
+struct Command_Buffer {
+    static constexpr size_t page_bits = 6;
+    static constexpr size_t page_size = size_t(1) << page_bits;
+    static constexpr size_t page_count = 64; // Lanes 0 to 4095.
+
+    // A buffer for code that has no better place to keep one.
+    static Command_Buffer& global() { static Command_Buffer* buffer = new Command_Buffer; return *buffer; }
+
+    Command_Buffer() = default;
+    ~Command_Buffer() { for (auto& page : pages) delete[] page.load(); }
+    Command_Buffer(const Command_Buffer&) = delete;
+    Command_Buffer& operator = (const Command_Buffer&) = delete;
+
+    // Subscribes a token to a Behavior, Batch_Behavior or Static_Datum at the next flush.
+    template<class C> void subscribe(size_t token, C& container) { batch<Subscribe<C>>(container, subscribing).tokens.push_back(token); }
+    // Unsubscribes a token from a Behavior, Batch_Behavior or Static_Datum at the next flush.
+    template<class C> void unsubscribe(size_t token, C& container) { erase(token, container); }
+
+    // Gives a token a value at the next flush.
+    template<class T> void assign(size_t token, Datum<T>& datum, T value) { assign_to<T>(token, datum, std::move(value)); }
+    template<class T> void assign(size_t token, Dense_Datum<T>& datum, T value) { assign_to<T>(token, datum, std::move(value)); }
+    template<class T> void assign(size_t token, Paged_Datum<T>& datum, T value) { assign_to<T>(token, datum, std::move(value)); }
+    template<class T, size_t N> void assign(size_t token, Buffered_Datum<T, N>& datum, T value) { assign_to<T>(token, datum, std::move(value)); }
+    template<class T, auto... Fs> void assign(size_t token, Soa_Datum<T, Fs...>& datum, T value) { assign_to<T>(token, datum, std::move(value)); }
+
+    // Removes a token from any container at the next flush.
+    template<class C> void erase(size_t token, C& container) { batch<Erase<C>>(container, erasing).tokens.push_back(token); }
+
+    // Moves a token to another partition of a Behavior or Batch_Behavior at the next flush.
+    // Usage: `commands.move(Think.context(), Think, 1);` puts the running token to sleep.
+    template<class C> void move(size_t token, C& container, size_t partition) {
+        auto& b = batch<Move<C>>(container, moving);
+        b.tokens.push_back(token);
+        b.partitions.push_back(partition);
+    }
+
+    // Destroys a token at the next flush, after every other command.
+    void destroy(size_t token) { local().destroyed.push_back(token); }
+
+    // Applies every recorded command, from all lanes, and empties the buffer.
+    // Returns the number of commands applied.
+    size_t flush() {
+        std::unordered_map<uintptr_t, Batch*> merged;
+        std::vector<size_t> destroyed;
+        each_lane([&](Lane& lane) {
+            for (auto& [key, batch] : lane.batches) {
+                auto [it, fresh] = merged.emplace(key, batch.get());
+                if (!fresh) it->second->absorb(*batch);
+            }
+            destroyed.insert(destroyed.end(), lane.destroyed.begin(), lane.destroyed.end());
+        });
+        size_t applied = 0;
+        for (auto& [key, batch] : merged) if ((key & 3) == subscribing || (key & 3) == assigning) applied += batch->apply();
+        for (auto& [key, batch] : merged) if ((key & 3) == moving) applied += batch->apply();
+        for (auto& [key, batch] : merged) if ((key & 3) == erasing) applied += batch->apply();
+
+        applied += destroyed.size();
+        std::sort(destroyed.begin(), destroyed.end());
+        destroyed.erase(std::unique(destroyed.begin(), destroyed.end()), destroyed.end());
+        std::erase_if(destroyed, [](size_t token) { return !Token_Registry::global().alive(token); });
+        if (!destroyed.empty()) Token::destroy(destroyed);
+
+        each_lane([](Lane& lane) { lane.batches.clear(); lane.destroyed.clear(); lane.last = nullptr; });
+        return applied;
+    }
+
+private:
+    // The commands recorded against one container, of one kind. Containers are at least
+    // 4-byte aligned, so a batch's key is the container's address with the kind in the low bits.
+    struct Batch {
+        virtual ~Batch() = default;
+        virtual void absorb(Batch& other) = 0; // Takes over another lane's commands for the same container.
+        virtual size_t apply() = 0;
+    };
+    static constexpr uintptr_t subscribing = 0, assigning = 1, erasing = 2, moving = 3;
+
+    template<class C> struct Subscribe : Batch {
+        C* container;
+        std::vector<size_t> tokens;
+        Subscribe(C* icontainer) : container(icontainer) {}
+        void absorb(Batch& other) override { auto& o = static_cast<Subscribe&>(other); tokens.insert(tokens.end(), o.tokens.begin(), o.tokens.end()); }
+        size_t apply() override { sort<C>(tokens); std::span<const size_t>(tokens) += *container; return tokens.size(); }
+    };
+
+    template<class C> struct Erase : Batch {
+        C* container;
+        std::vector<size_t> tokens;
+        Erase(C* icontainer) : container(icontainer) {}
+        void absorb(Batch& other) override { auto& o = static_cast<Erase&>(other); tokens.insert(tokens.end(), o.tokens.begin(), o.tokens.end()); }
+        size_t apply() override { sort<C>(tokens); container->erase(std::span<const size_t>(tokens)); return tokens.size(); }
+    };
+
+    template<class C> struct Move : Batch {
+        C* container;
+        std::vector<size_t> tokens;
+        std::vector<size_t> partitions;
+        Move(C* icontainer) : container(icontainer) {}
+        void absorb(Batch& other) override {
+            auto& o = static_cast<Move&>(other);
+            tokens.insert(tokens.end(), o.tokens.begin(), o.tokens.end());
+            partitions.insert(partitions.end(), o.partitions.begin(), o.partitions.end());
+        }
+        size_t apply() override {
+            for (size_t i = 0; i < tokens.size(); ++i) container->move(tokens[i], partitions[i]);
+            return tokens.size();
+        }
+    };
+
+    template<class D, class T> struct Assign : Batch {
+        D* datum;
+        std::vector<size_t> tokens;
+        std::vector<T> values;
+        Assign(D* idatum) : datum(idatum) {}
+        void absorb(Batch& other) override {
+            auto& o = static_cast<Assign&>(other);
+            tokens.insert(tokens.end(), o.tokens.begin(), o.tokens.end());
+            values.insert(values.end(), std::make_move_iterator(o.values.begin()), std::make_move_iterator(o.values.end()));
+        }
+        size_t apply() override {
+            if (!sorts<D> || sorted(tokens)) {
+                datum->assign(std::span<const size_t>(tokens), std::span<const T>(values));
+                return tokens.size();
+            }
+            // A stable sort keeps repeated assignments in recording order, so the last one wins.
+            std::vector<size_t> order(tokens.size());
+            for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+            std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return Token_Set::slot(tokens[a]) < Token_Set::slot(tokens[b]); });
+            std::vector<size_t> sorted_tokens(order.size());
+            std::vector<T> sorted_values;
+            sorted_values.reserve(order.size());
+            for (size_t i = 0; i < order.size(); ++i) { sorted_tokens[i] = tokens[order[i]]; sorted_values.push_back(std::move(values[order[i]])); }
+            datum->assign(std::span<const size_t>(sorted_tokens), std::span<const T>(sorted_values));
+            return tokens.size();
+        }
+    };
+
+    struct alignas(64) Lane {
+        std::unordered_map<uintptr_t, std::unique_ptr<Batch>> batches;
+        std::vector<size_t> destroyed;
+        uintptr_t last_key = 0;  // The most recently used batch, so runs of commands skip the map.
+        Batch* last = nullptr;
+    };
+
+    // Only Token_Set backed containers gain from ascending tokens; hashed ones take them as they come.
+    template<class C> static constexpr bool sorts = requires(C& c) { c.tokens.sorted; };
+    static bool sorted(const std::vector<size_t>& tokens) {
+        return std::is_sorted(tokens.begin(), tokens.end(), [](size_t a, size_t b) { return Token_Set::slot(a) < Token_Set::slot(b); });
+    }
+    template<class C> static void sort(std::vector<size_t>& tokens) {
+        if (!sorts<C> || sorted(tokens)) return;
+        std::sort(tokens.begin(), tokens.end(), [](size_t a, size_t b) { return Token_Set::slot(a) < Token_Set::slot(b); });
+    }
+
+    template<class T, class D> void assign_to(size_t token, D& datum, T value) {
+        auto& b = batch<Assign<D, T>>(datum, assigning);
+        b.tokens.push_back(token);
+        b.values.push_back(std::move(value));
+    }
+
+    template<class B, class C> B& batch(C& container, uintptr_t kind) {
+        Lane& lane = local();
+        uintptr_t key = uintptr_t(&container) | kind;
+        if (lane.last && lane.last_key == key) return static_cast<B&>(*lane.last);
+        std::unique_ptr<Batch>& slot = lane.batches[key];
+        if (!slot) slot = std::make_unique<B>(&container);
+        lane.last_key = key;
+        lane.last = slot.get();
+        return static_cast<B&>(*slot);
+    }
+
+    // The calling thread's lane ID: its pool lane, or one it holds until it exits.
+    static size_t recording_lane() {
+        if (size_t lane = Thread_Pool::lane()) return lane;
+        struct Owned {
+            size_t id = Thread_Pool::claim();
+            ~Owned() { Thread_Pool::release(id); }
+        };
+        static thread_local Owned owned;
+        return owned.id;
+    }
+
+    // Returns the calling thread's lane, allocating its page on first use.
+    Lane& local() {
+        size_t lane = recording_lane();
+        if ((lane >> page_bits) >= page_count) throw std::length_error("Command_Buffer ran out of lanes.");
+        std::atomic<Lane*>& slot = pages[lane >> page_bits];
+        Lane* page = slot.load(std::memory_order_acquire);
+        if (!page) {
+            Lane* fresh = new Lane[page_size];
+            if (slot.compare_exchange_strong(page, fresh, std::memory_order_acq_rel)) page = fresh;
+            else delete[] fresh;
+        }
+        return page[lane & (page_size - 1)];
+    }
+
+    template<class F> void each_lane(F&& f) {
+        for (auto& slot : pages) if (Lane* page = slot.load(std::memory_order_acquire)) for (size_t i = 0; i < page_size; ++i) f(page[i]);
+    }
+
+    std::array<std::atomic<Lane*>, page_count> pages{}; // Lanes, in fixed pages that never move.
+};
 #pragma endregion
 
+#pragma region Queries
+// -----------------------------------------------------------------------------
+// Query_Traits: Describes how a Query walks and probes one container.
+// `size` and `contains` drive the intersection, `each` enumerates member tokens,
+// and `get` returns what the query yields for a member token. `ordered` containers
+// are Token_Set backed. Datums are walked in storage order and never reordered by
+// a query, so columns from `align`, `field` or a Batch_Behavior stay valid;
+// behaviors sort their subscribers first, as a broadcast would.
+// -----------------------------------------------------------------------------
+template<class T>
+struct Query_Traits<Datum<T>> {
+    static constexpr bool ordered = false;
+    static size_t size(Datum<T>& d) { return d.data.size(); }
+    static bool contains(Datum<T>& d, size_t token) { return d.contains(token); }
+    template<class F> static void each(Datum<T>& d, F&& f) { for (auto& [token, value] : d.data) f(token); }
+    static T& get(Datum<T>& d, size_t token) { return *d.find(token); }
+};
+
+template<class T, size_t N>
+struct Query_Traits<Buffered_Datum<T, N>> {
+    static constexpr bool ordered = false;
+    static size_t size(Buffered_Datum<T, N>& d) { return d.size(); }
+    static bool contains(Buffered_Datum<T, N>& d, size_t token) { return d.contains(token); }
+    template<class F> static void each(Buffered_Datum<T, N>& d, F&& f) { for (auto& [token, value] : d.buffers[d.back].data) f(token); }
+    static T& get(Buffered_Datum<T, N>& d, size_t token) { return *d.find(token); }
+};
+
+template<class T>
+struct Query_Traits<Dense_Datum<T>> {
+    static constexpr bool ordered = true;
+    static size_t size(Dense_Datum<T>& d) { return d.size(); }
+    static bool contains(Dense_Datum<T>& d, size_t token) { return d.contains(token); }
+    template<class F> static void each(Dense_Datum<T>& d, F&& f) { for (size_t i = 0; i < d.tokens.size(); ++i) f(d.tokens.dense[i]); }
+    static T& get(Dense_Datum<T>& d, size_t token) { return d.data[d.tokens.index(token)]; }
+};
+
+template<class T>
+struct Query_Traits<Paged_Datum<T>> {
+    static constexpr bool ordered = true;
+    static size_t size(Paged_Datum<T>& d) { return d.size(); }
+    static bool contains(Paged_Datum<T>& d, size_t token) { return d.contains(token); }
+    template<class F> static void each(Paged_Datum<T>& d, F&& f) { d.each([&](size_t token, T&) { f(token); }); }
+    static T& get(Paged_Datum<T>& d, size_t token) { return *d.find(token); }
+};
+
+template<class T>
+struct Query_Traits<Static_Datum<T>> {
+    static constexpr bool ordered = false;
+    static size_t size(Static_Datum<T>& d) { return d.tokens.size(); }
+    static bool contains(Static_Datum<T>& d, size_t token) { return d.contains(token); }
+    template<class F> static void each(Static_Datum<T>& d, F&& f) { for (size_t token : d.tokens) f(token); }
+    static T& get(Static_Datum<T>& d, size_t) { return d.data; }
+};
+
+template<class T>
+struct Query_Traits<Solitary_Datum<T>> {
+    static constexpr bool ordered = false;
+    static size_t size(Solitary_Datum<T>& d) { return d.token ? 1 : 0; }
+    static bool contains(Solitary_Datum<T>& d, size_t token) { return d.contains(token); }
+    template<class F> static void each(Solitary_Datum<T>& d, F&& f) { if (d.token) f(d.token); }
+    static T& get(Solitary_Datum<T>& d, size_t) { return d.data; }
+};
+
+template<class T>
+struct Query_Traits<Shared_Datum<T>> {
+    static constexpr bool ordered = false;
+    static size_t size(Shared_Datum<T>& d) { return d.pools.size(); }
+    static bool contains(Shared_Datum<T>& d, size_t token) { return d.contains(token); }
+    template<class F> static void each(Shared_Datum<T>& d, F&& f) { for (auto& [token, pool] : d.pools) f(token); }
+    static T& get(Shared_Datum<T>& d, size_t token) { return *d.find(token); }
+};
+
+template<class T, class A, size_t I>
+struct Query_Traits<Archetype_Column<T, A, I>> {
+    static constexpr bool ordered = false;
+    static size_t size(Archetype_Column<T, A, I>& c) { return c.archetype->size(); }
+    static bool contains(Archetype_Column<T, A, I>& c, size_t token) { return c.contains(token); }
+    template<class F> static void each(Archetype_Column<T, A, I>& c, F&& f) { for (size_t token : c.archetype->tokens) f(token); }
+    static T& get(Archetype_Column<T, A, I>& c, size_t token) { return *c.find(token); }
+};
+
+// A Soa_Datum yields a Row handle by value; take it as `auto` and call `get<I>()` or convert it.
+template<class T, auto... Fs>
+struct Query_Traits<Soa_Datum<T, Fs...>> {
+    static constexpr bool ordered = true;
+    static size_t size(Soa_Datum<T, Fs...>& d) { return d.size(); }
+    static bool contains(Soa_Datum<T, Fs...>& d, size_t token) { return d.contains(token); }
+    template<class F> static void each(Soa_Datum<T, Fs...>& d, F&& f) { for (size_t i = 0; i < d.tokens.size(); ++i) f(d.tokens.dense[i]); }
+    static typename Soa_Datum<T, Fs...>::Row get(Soa_Datum<T, Fs...>& d, size_t token) { return { &d, d.tokens.index(token) }; }
+};
+
+// Behaviors filter by subscription, counting partition 0 only, and yield themselves,
+// so `behavior[token]()` can be called.
+template<class R, class Fn, class... Args>
+struct Query_Traits<Behavior<R(Args...), Fn>> {
+    static constexpr bool ordered = true;
+    static size_t size(Behavior<R(Args...), Fn>& b) { return b.tokens.members(0).size(); }
+    static bool contains(Behavior<R(Args...), Fn>& b, size_t token) { return b.awake(token); }
+    template<class F> static void each(Behavior<R(Args...), Fn>& b, F&& f) { b.tokens.sort(0); for (size_t token : b.tokens.members(0)) f(token); }
+    static Behavior<R(Args...), Fn>& get(Behavior<R(Args...), Fn>& b, size_t) { return b; }
+};
+
+template<class R, class... Args>
+struct Query_Traits<Batch_Behavior<R(Args...)>> {
+    static constexpr bool ordered = true;
+    static size_t size(Batch_Behavior<R(Args...)>& b) { return b.tokens.members(0).size(); }
+    static bool contains(Batch_Behavior<R(Args...)>& b, size_t token) { return b.awake(token); }
+    template<class F> static void each(Batch_Behavior<R(Args...)>& b, F&& f) { b.tokens.sort(0); for (size_t token : b.tokens.members(0)) f(token); }
+    static Batch_Behavior<R(Args...)>& get(Batch_Behavior<R(Args...)>& b, size_t) { return b; }
+};
+
+// -----------------------------------------------------------------------------
+// Query: Visits every token that is a member of all the given containers.
+// The smallest container drives the walk and every other one is probed, so the
+// cost is O(smallest * containers) and nothing is allocated. A Dense_Datum or
+// Soa_Datum driver is walked in its storage order, ascending once it has been
+// sorted; call its `sort` first for ascending token order, which keeps probes into
+// other Token_Set backed containers moving forward through memory.
+// Example:
+//     Query(Position, Velocity, Move).each([](size_t token, Vec3& p, Vec3& v, auto& move) { ... });
+// Values may be modified inside `each`, but tokens must not join or leave the queried containers.
+// -----------------------------------------------------------------------------
+template<class... Ds>
+struct Query {
+    std::tuple<Ds&...> containers;
+
+    Query(Ds&... icontainers) : containers(icontainers...) {}
+
+    // Calls `f(token, values...)` for every token found in all containers.
+    template<class F> void each(F&& f) {
+        each(std::forward<F>(f), std::index_sequence_for<Ds...>{});
+    }
+
+    // Returns the number of tokens found in all containers.
+    size_t count() {
+        size_t n = 0;
+        each([&](size_t, auto&&...) { ++n; });
+        return n;
+    }
+
+private:
+    template<class F, size_t... I> void each(F&& f, std::index_sequence<I...>) {
+        size_t sizes[] = { Query_Traits<Ds>::size(std::get<I>(containers))... };
+        bool ordered[] = { Query_Traits<Ds>::ordered... };
+        size_t driver = 0;
+        for (size_t i = 1; i < sizeof...(Ds); ++i) {
+            // Ties go to ordered containers, whose walk is one contiguous array.
+            if (sizes[i] < sizes[driver] || (sizes[i] == sizes[driver] && ordered[i] && !ordered[driver])) driver = i;
+        }
+        ((I == driver ? (drive<I>(f, std::index_sequence<I...>{}), true) : false) || ...);
+    }
+
+    template<size_t D, class F, size_t... I> void drive(F& f, std::index_sequence<I...>) {
+        using Driver = std::tuple_element_t<D, std::tuple<Ds...>>;
+        Query_Traits<Driver>::each(std::get<D>(containers), [&](size_t token) {
+            if (!((I == D || Query_Traits<Ds>::contains(std::get<I>(containers), token)) && ...)) return;
+            f(token, Query_Traits<Ds>::get(std::get<I>(containers), token)...);
+        });
+    }
+};
+
+template<class... Ds> Query(Ds&...) -> Query<Ds...>;
 #pragma endregion
 
 
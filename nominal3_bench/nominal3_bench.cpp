@@ -0,0 +1,347 @@
+// nominal3_bench.cpp : Microbenchmarks for the core containers and behavior dispatch.
+//
+// Usage: nominal3_bench [--min N] [--max N] [--filter text]
+// Every benchmark runs at 1k, 10k, ... up to --max tokens (10M by default) and
+// reports the time per operation, the heap allocations per operation and the peak
+// heap usage while it ran. "soa" rows are plain struct-of-arrays baselines.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include "../nominal3/nominal.async.h"
+#include "../nominal3/nominal.index.h"
+#include "../nominal3/nominal.v.3.0.h"
+
+#pragma region Allocation Tracking
+// Every heap allocation goes through these replacements, which keep a small header
+// in front of each block so live and peak byte counts stay exact.
+namespace heap {
+    std::atomic<size_t> allocations = 0;
+    std::atomic<size_t> live = 0;
+    std::atomic<size_t> peak = 0;
+
+    struct Header { void* base; size_t size; };
+
+    void* allocate(size_t size, size_t align) {
+        if (align < alignof(Header)) align = alignof(Header);
+        size_t offset = (sizeof(Header) + align - 1) / align * align;
+        void* base = std::malloc(size + offset + align);
+        if (!base) throw std::bad_alloc();
+        uintptr_t p = (reinterpret_cast<uintptr_t>(base) + offset + align - 1) / align * align;
+        Header* header = reinterpret_cast<Header*>(p) - 1;
+        header->base = base;
+        header->size = size;
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        size_t now = live.fetch_add(size, std::memory_order_relaxed) + size;
+        size_t high = peak.load(std::memory_order_relaxed);
+        while (now > high && !peak.compare_exchange_weak(high, now, std::memory_order_relaxed)) {}
+        return reinterpret_cast<void*>(p);
+    }
+
+    void release(void* p) {
+        if (!p) return;
+        Header* header = static_cast<Header*>(p) - 1;
+        live.fetch_sub(header->size, std::memory_order_relaxed);
+        std::free(header->base);
+    }
+}
+
+void* operator new (size_t size) { return heap::allocate(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__); }
+void* operator new[] (size_t size) { return heap::allocate(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__); }
+void* operator new (size_t size, std::align_val_t align) { return heap::allocate(size, size_t(align)); }
+void* operator new[] (size_t size, std::align_val_t align) { return heap::allocate(size, size_t(align)); }
+void operator delete (void* p) noexcept { heap::release(p); }
+void operator delete[] (void* p) noexcept { heap::release(p); }
+void operator delete (void* p, size_t) noexcept { heap::release(p); }
+void operator delete[] (void* p, size_t) noexcept { heap::release(p); }
+void operator delete (void* p, std::align_val_t) noexcept { heap::release(p); }
+void operator delete[] (void* p, std::align_val_t) noexcept { heap::release(p); }
+void operator delete (void* p, size_t, std::align_val_t) noexcept { heap::release(p); }
+void operator delete[] (void* p, size_t, std::align_val_t) noexcept { heap::release(p); }
+#pragma endregion
+
+#pragma region Harness
+volatile size_t sink; // Keeps results observable so loops are not optimized away.
+
+struct Options {
+    size_t min = 1000;
+    size_t max = 10000000;
+    std::string filter;
+} options;
+
+// Runs `f` once, where `f` performs `ops` operations, and prints one result row.
+template<class F> void measure(const char* name, size_t tokens, size_t ops, F&& f) {
+    if (!options.filter.empty() && std::string(name).find(options.filter) == std::string::npos) return;
+    size_t allocations = heap::allocations.load();
+    heap::peak.store(heap::live.load());
+    size_t base = heap::live.load();
+    auto start = std::chrono::steady_clock::now();
+    f();
+    auto stop = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(stop - start).count();
+    double allocs = double(heap::allocations.load() - allocations);
+    double peak = double(heap::peak.load() - base) / (1024.0 * 1024.0);
+    std::printf("%-34s %10zu %12.2f %12.3f %12.2f\n", name, tokens, ns / double(ops ? ops : 1), allocs / double(ops ? ops : 1), peak);
+    std::fflush(stdout);
+}
+
+// Token IDs 1..n, used directly so the benchmarks do not depend on registry state.
+std::vector<size_t> make_ids(size_t n) {
+    std::vector<size_t> ids(n);
+    for (size_t i = 0; i < n; ++i) ids[i] = i + 1;
+    return ids;
+}
+
+// A fixed pseudo-random permutation, for lookups that defeat the prefetcher.
+std::vector<size_t> shuffled(std::vector<size_t> ids) {
+    uint64_t state = 0x9E3779B97F4A7C15ull;
+    for (size_t i = ids.size(); i > 1; --i) {
+        state ^= state << 13; state ^= state >> 7; state ^= state << 17;
+        std::swap(ids[i - 1], ids[state % i]);
+    }
+    return ids;
+}
+#pragma endregion
+
+#pragma region Benchmarks
+void bench_datum(std::vector<size_t>& ids, std::vector<size_t>& random) {
+    size_t n = ids.size();
+    Datum<int> D;
+    measure("datum/insert", n, n, [&] { for (size_t& t : ids) t + D = int(t); });
+    measure("datum/lookup-random", n, n, [&] { size_t s = 0; for (size_t t : random) s += D[t]; sink = s; });
+    measure("datum/iterate", n, n, [&] { size_t s = 0; for (auto& [t, v] : D.data) s += v; sink = s; });
+    measure("datum/erase", n, n, [&] { size_t s = 0; for (size_t& t : ids) s += t - D; sink = s; });
+    measure("datum/assign-bulk", n, n, [&] { D.assign(ids, 1); });
+    Command_Buffer commands;
+    measure("datum/erase-deferred", n, n, [&] { for (size_t t : random) commands.erase(t, D); commands.flush(); });
+    measure("datum/assign-deferred", n, n, [&] { for (size_t t : random) commands.assign(t, D, 1); commands.flush(); });
+    D.erase(ids);
+
+    Pool_Resource pool(64, 4096);
+    Datum<int> P(&pool);
+    measure("datum/insert-pool", n, n, [&] { for (size_t& t : ids) t + P = int(t); });
+    measure("datum/erase-pool", n, n, [&] { size_t s = 0; for (size_t& t : ids) s += t - P; sink = s; });
+
+    // Spawn and drop a whole frame's worth of data; the arena takes it back in one reset.
+    Frame_Arena arena;
+    measure("datum/frame-arena", n, n, [&] {
+        { Datum<int> A(&arena); for (size_t& t : ids) t + A = int(t); }
+        arena.reset();
+    });
+}
+
+void bench_dense_datum(std::vector<size_t>& ids, std::vector<size_t>& random) {
+    size_t n = ids.size();
+    Dense_Datum<int> D;
+    measure("dense_datum/insert", n, n, [&] { for (size_t& t : ids) t + D = int(t); });
+    measure("dense_datum/lookup-random", n, n, [&] { size_t s = 0; for (size_t t : random) s += D[t]; sink = s; });
+    measure("dense_datum/iterate", n, n, [&] { size_t s = 0; for (int v : D.data) s += v; sink = s; });
+    measure("dense_datum/erase", n, n, [&] { size_t s = 0; for (size_t& t : ids) s += t - D; sink = s; });
+    measure("dense_datum/assign-bulk", n, n, [&] { D.assign(ids, 1); });
+    D.track();
+    measure("dense_datum/write-tracked", n, n, [&] { for (size_t& t : ids) t + D = 2; });
+    measure("dense_datum/changes-since", n, n, [&] { size_t s = 0; D.log.since(0, [&](size_t t, Change_Log::Kind) { s += t; }); sink = s; });
+}
+
+void bench_paged_datum(std::vector<size_t>& ids, std::vector<size_t>& random) {
+    size_t n = ids.size();
+    Paged_Datum<int> D;
+    measure("paged_datum/insert", n, n, [&] { for (size_t& t : ids) t + D = int(t); });
+    measure("paged_datum/lookup-random", n, n, [&] { size_t s = 0; for (size_t t : random) s += D[t]; sink = s; });
+    measure("paged_datum/iterate", n, n, [&] { size_t s = 0; D.each([&](size_t, int v) { s += v; }); sink = s; });
+    measure("paged_datum/erase", n, n, [&] { size_t s = 0; for (size_t& t : ids) s += t - D; sink = s; });
+
+    Paged_Datum<int> R;
+    R.reserve(n + 1);
+    measure("paged_datum/insert-reserved", n, n, [&] { for (size_t& t : ids) t + R = int(t); });
+}
+
+void bench_buffered_datum(std::vector<size_t>& ids, std::vector<size_t>& random) {
+    size_t n = ids.size();
+    Buffered_Datum<int> D;
+    measure("buffered_datum/insert", n, n, [&] { for (size_t& t : ids) t + D = int(t); });
+    measure("buffered_datum/publish-all", n, n, [&] { D.publish(); });
+    size_t few = std::max<size_t>(1, n / 100);
+    measure("buffered_datum/publish-1pct", n, few, [&] { for (size_t i = 0; i < few; ++i) D[random[i]] += 1; D.publish(); });
+    measure("buffered_datum/read-random", n, n, [&] { size_t s = 0; auto view = D.read(); for (size_t t : random) s += *view.find(t); sink = s; });
+    // The copy a double buffer without dirty tracking would make every frame.
+    measure("buffered_datum/full-copy-baseline", n, n, [&] { std::pmr::unordered_map<size_t, int> copy = D.buffers[D.back].data; sink = copy.size(); });
+}
+
+void bench_shared_datum(std::vector<size_t>& ids, std::vector<size_t>& random) {
+    size_t n = ids.size();
+    Shared_Datum<int> D;
+    // Sixteen tokens per pool.
+    measure("shared_datum/insert", n, n, [&] { for (size_t& t : ids) { if (t % 16 == 1) t + D = int(t); else t >> D; } });
+    measure("shared_datum/lookup-random", n, n, [&] { size_t s = 0; for (size_t t : random) s += D[t]; sink = s; });
+    measure("shared_datum/erase", n, n, [&] { size_t s = 0; for (size_t& t : ids) s += t - D; sink = s; });
+}
+
+void bench_static_datum(std::vector<size_t>& ids, std::vector<size_t>& random) {
+    size_t n = ids.size();
+    Static_Datum<int> D(7);
+    measure("static_datum/subscribe", n, n, [&] { for (size_t& t : ids) t += D; });
+    measure("static_datum/lookup-random", n, n, [&] { size_t s = 0; for (size_t t : random) s += D[t]; sink = s; });
+    measure("static_datum/unsubscribe", n, n, [&] { for (size_t& t : ids) t -= D; });
+}
+
+void bench_prefab(std::vector<size_t>& ids, std::vector<size_t>&) {
+    size_t n = ids.size();
+    Datum<int> Health;
+    Dense_Datum<float> Speed;
+    Static_Datum<int> Kind(3);
+    Behavior<void()> Think = { [] {} };
+    std::vector<Datum<int>> unrelated(16); // Containers the prefab is not in, skipped by the membership masks.
+    size_t prefab = n + 1; // Outside the cloned IDs, so cloning and destroying them never touches it.
+    prefab + Health = 100; prefab + Speed = 2.0f; prefab += Kind; prefab += Think;
+    measure("prefab/clone", n, n, [&] { Token::clone(prefab, ids); });
+    measure("prefab/destroy", n, n, [&] { Container_Registry::global().erase(ids); });
+    Container_Registry::global().erase(std::span<const size_t>(&prefab, 1));
+}
+
+void bench_behavior(std::vector<size_t>& ids, std::vector<size_t>& random) {
+    size_t n = ids.size();
+    Dense_Datum<int> Value;
+    for (size_t& t : ids) t + Value = 1;
+
+    Behavior<void()> Classic = { [&]() { Classic[Value] += 1; } };
+    auto Inline = make_behavior<void()>([&](auto& self) { self[Value] += 1; });
+    Batch_Behavior<void()> Batch = { [&](std::span<const size_t> tokens) {
+        auto values = Batch[Value];
+        for (size_t i = 0; i < tokens.size(); ++i) values[i] += 1;
+    } };
+
+    measure("behavior/subscribe", n, n, [&] { for (size_t& t : ids) t += Classic; });
+    for (size_t& t : ids) { t += Inline; t += Batch; }
+    measure("behavior/broadcast", n, n, [&] { Classic(); });
+    measure("behavior/broadcast-inline", n, n, [&] { Inline(); });
+    Batch(); // Align the column once; later broadcasts only verify it.
+    measure("behavior/broadcast-batch", n, n, [&] { Batch(); });
+    measure("behavior/token-dispatch", n, n, [&] { for (size_t t : random) Classic[t](); });
+    measure("behavior/token-dispatch-inline", n, n, [&] { for (size_t t : random) Inline[t](); });
+    measure("behavior/churn", n, 2 * n, [&] {
+        for (size_t t : random) { t -= Classic; }
+        for (size_t t : random) { t += Classic; }
+    });
+    measure("behavior/unsubscribe", n, n, [&] { for (size_t t : random) t -= Classic; });
+    measure("behavior/subscribe-bulk", n, n, [&] { ids += Classic; });
+    measure("behavior/unsubscribe-bulk", n, n, [&] { ids -= Classic; });
+
+    // Nine tokens in ten idle: an early-out on a flag datum against a sleeping partition.
+    Datum<bool> Active;
+    for (size_t t : ids) Active[t] = t % 10 == 0;
+    Behavior<void()> Checked = { [&]() { if (Checked[Active]) Checked[Value] += 1; } };
+    Behavior<void()> Partitioned = { [&]() { Partitioned[Value] += 1; } };
+    ids += Checked;
+    ids += Partitioned;
+    for (size_t t : ids) if (t % 10) Partitioned.sleep(t);
+    Checked(); Partitioned(); // Warm both, and sort the awake partition once.
+    measure("behavior/broadcast-10pct-flag", n, n, [&] { Checked(); });
+    measure("behavior/broadcast-10pct-asleep", n, n, [&] { Partitioned(); });
+    measure("behavior/sleep-wake", n, 2 * n, [&] {
+        for (size_t t : random) Partitioned.wake(t);
+        for (size_t t : random) if (t % 10) Partitioned.sleep(t);
+    });
+}
+
+void bench_async_behavior(std::vector<size_t>& ids, std::vector<size_t>&) {
+    size_t n = ids.size();
+    Datum<int> D;
+    for (size_t t : ids) D[t] = int(t);
+    size_t s = 0;
+    // Every task suspends once, so a round is one broadcast plus one poll per token.
+    Async_Behavior<void()> B = { [&]() -> Async_Task { co_await next_frame; s += B[D]; } };
+    for (size_t& t : ids) t += B;
+    measure("async_behavior/start-suspend-resume", n, n, [&] { B(); B.poll(); sink = s; });
+}
+
+void bench_archetype(std::vector<size_t>& ids, std::vector<size_t>& random) {
+    size_t n = ids.size();
+    Archetype<int, int> A;
+    auto& [Value, Step] = A.columns;
+    measure("archetype/insert", n, n, [&] { for (size_t& t : ids) t + A; });
+    measure("archetype/lookup-random", n, n, [&] { size_t s = 0; for (size_t t : random) s += Value[t]; sink = s; });
+    measure("archetype/iterate-chunks", n, n, [&] {
+        for (size_t c = 0; c < A.chunk_count(); ++c) {
+            std::span<int> values = Value.chunk(c), steps = Step.chunk(c);
+            for (size_t i = 0; i < values.size(); ++i) values[i] += steps[i];
+        }
+    });
+    measure("archetype/erase", n, n, [&] { for (size_t& t : ids) t - A; });
+}
+
+void bench_index(std::vector<size_t>& ids, std::vector<size_t>& random) {
+    size_t n = ids.size();
+    Datum<float> Health;
+    for (size_t& t : ids) t + Health = float(t % 1000);
+    std::optional<Ordered_Index<Datum<float>>> index;
+    measure("index/build-ordered", n, n, [&] { index.reset(); index.emplace(Health); });
+    // Select about 1% of the tokens, by scanning and through the index.
+    measure("index/scan-1pct", n, n, [&] { size_t s = 0; for (auto& [t, h] : Health.data) if (h < 10.0f) ++s; sink = s; });
+    measure("index/range-1pct", n, n, [&] { sink = index->below(10.0f).size(); });
+    measure("index/update", n, n, [&] { for (size_t t : random) Health[t] += 1.0f; index->refresh(); });
+}
+
+struct Vec3 { float x, y, z; };
+
+void bench_soa_datum(std::vector<size_t>& ids, std::vector<size_t>& random) {
+    size_t n = ids.size();
+    Soa_Datum<Vec3, &Vec3::x, &Vec3::y, &Vec3::z> Position, Velocity;
+    Dense_Datum<Vec3> Packed;
+    measure("soa_datum/insert", n, n, [&] { for (size_t& t : ids) { t + Position = Vec3{ 1, 2, 3 }; t + Velocity = Vec3{ 1, 1, 1 }; } });
+    measure("soa_datum/lookup-random", n, n, [&] { float s = 0; for (size_t t : random) s += Position[t].get<0>(); sink = size_t(s); });
+    Position.sort(); Velocity.sort();
+    measure("soa_datum/integrate-kernel", n, n, [&] {
+        kernel::axpy(Position.field<0>(), Velocity.field<0>(), 0.016f);
+        kernel::axpy(Position.field<1>(), Velocity.field<1>(), 0.016f);
+        kernel::axpy(Position.field<2>(), Velocity.field<2>(), 0.016f);
+    });
+    // The same integration over packed structs, for comparison.
+    for (size_t& t : ids) t + Packed = Vec3{ 1, 2, 3 };
+    measure("dense_datum/integrate-aos", n, n, [&] {
+        for (Vec3& p : Packed.data) { p.x += 0.016f; p.y += 0.016f; p.z += 0.016f; }
+    });
+    measure("soa_datum/erase", n, n, [&] { for (size_t& t : ids) t - Position; });
+}
+
+void bench_soa(std::vector<size_t>& ids, std::vector<size_t>& random) {
+    size_t n = ids.size();
+    // The baseline a hand-written system would use: values indexed directly by token ID.
+    std::vector<int> values;
+    measure("soa/insert", n, n, [&] { values.resize(n + 1); for (size_t t : ids) values[t] = int(t); });
+    measure("soa/lookup-random", n, n, [&] { size_t s = 0; for (size_t t : random) s += values[t]; sink = s; });
+    measure("soa/iterate", n, n, [&] { size_t s = 0; for (int v : values) s += v; sink = s; });
+    measure("soa/update", n, n, [&] { for (int& v : values) v += 1; });
+}
+#pragma endregion
+
+int main(int argc, char** argv)
+{
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (!std::strcmp(argv[i], "--min")) options.min = std::strtoull(argv[i + 1], nullptr, 10);
+        else if (!std::strcmp(argv[i], "--max")) options.max = std::strtoull(argv[i + 1], nullptr, 10);
+        else if (!std::strcmp(argv[i], "--filter")) options.filter = argv[i + 1];
+    }
+
+    std::printf("%-34s %10s %12s %12s %12s\n", "benchmark", "tokens", "ns/op", "allocs/op", "peak MiB");
+    for (size_t n = options.min; n <= options.max; n *= 10) {
+        std::vector<size_t> ids = make_ids(n);
+        std::vector<size_t> random = shuffled(ids);
+        bench_datum(ids, random);
+        bench_dense_datum(ids, random);
+        bench_paged_datum(ids, random);
+        bench_buffered_datum(ids, random);
+        bench_shared_datum(ids, random);
+        bench_static_datum(ids, random);
+        bench_prefab(ids, random);
+        bench_behavior(ids, random);
+        bench_async_behavior(ids, random);
+        bench_archetype(ids, random);
+        bench_soa_datum(ids, random);
+        bench_index(ids, random);
+        bench_soa(ids, random);
+    }
+}
@@ -0,0 +1,360 @@
+// nominal3_stress.cpp : An end-to-end load generator for the token pattern at scale.
+//
+// Usage: nominal3_stress [--min N] [--max N] [--frames N] [--threads N] [--lifetime N] [--mode text]
+// Keeps a population of --min, 10 * --min, ... up to --max tokens (1M by default) alive
+// while tokens spawn and die every frame, and runs twelve behaviors over them each frame:
+// serially, with every behavior spread over a Thread_Pool ("parallel"), and through a
+// Scheduler that also overlaps independent behaviors ("scheduled"). The pool runs at
+// 1, 2, 4, ... up to --threads threads (every core by default).
+//
+// Each run prints one row: the frame-time distribution, the time per live token, the
+// churn and the peak heap usage, and the speedup over the serial run of the same size.
+// The last run also prints its timeline: live tokens and heap usage as the frames went by.
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include "../nominal3/nominal.scheduler.h"
+#include "../nominal3/nominal.v.3.0.h"
+
+#pragma region Allocation Tracking
+// Every heap allocation goes through these replacements, which keep a small header
+// in front of each block so live and peak byte counts stay exact.
+namespace heap {
+    std::atomic<size_t> allocations = 0;
+    std::atomic<size_t> live = 0;
+    std::atomic<size_t> peak = 0;
+
+    struct Header { void* base; size_t size; };
+
+    void* allocate(size_t size, size_t align) {
+        if (align < alignof(Header)) align = alignof(Header);
+        size_t offset = (sizeof(Header) + align - 1) / align * align;
+        void* base = std::malloc(size + offset + align);
+        if (!base) throw std::bad_alloc();
+        uintptr_t p = (reinterpret_cast<uintptr_t>(base) + offset + align - 1) / align * align;
+        Header* header = reinterpret_cast<Header*>(p) - 1;
+        header->base = base;
+        header->size = size;
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        size_t now = live.fetch_add(size, std::memory_order_relaxed) + size;
+        size_t high = peak.load(std::memory_order_relaxed);
+        while (now > high && !peak.compare_exchange_weak(high, now, std::memory_order_relaxed)) {}
+        return reinterpret_cast<void*>(p);
+    }
+
+    void release(void* p) {
+        if (!p) return;
+        Header* header = static_cast<Header*>(p) - 1;
+        live.fetch_sub(header->size, std::memory_order_relaxed);
+        std::free(header->base);
+    }
+
+    double mib(size_t bytes) { return double(bytes) / (1024.0 * 1024.0); }
+}
+
+void* operator new (size_t size) { return heap::allocate(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__); }
+void* operator new[] (size_t size) { return heap::allocate(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__); }
+void* operator new (size_t size, std::align_val_t align) { return heap::allocate(size, size_t(align)); }
+void* operator new[] (size_t size, std::align_val_t align) { return heap::allocate(size, size_t(align)); }
+void operator delete (void* p) noexcept { heap::release(p); }
+void operator delete[] (void* p) noexcept { heap::release(p); }
+void operator delete (void* p, size_t) noexcept { heap::release(p); }
+void operator delete[] (void* p, size_t) noexcept { heap::release(p); }
+void operator delete (void* p, std::align_val_t) noexcept { heap::release(p); }
+void operator delete[] (void* p, std::align_val_t) noexcept { heap::release(p); }
+void operator delete (void* p, size_t, std::align_val_t) noexcept { heap::release(p); }
+void operator delete[] (void* p, size_t, std::align_val_t) noexcept { heap::release(p); }
+#pragma endregion
+
+#pragma region Harness
+struct Options {
+    size_t min = 10000;
+    size_t max = 1000000;
+    size_t frames = 60;
+    size_t threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+    size_t lifetime = 50; // The mean number of frames a token lives.
+    std::string mode;     // Runs only the modes whose name contains this.
+} options;
+
+enum class Mode { Serial, Parallel, Scheduled };
+const char* mode_names[] = { "serial", "parallel", "scheduled" };
+
+// A small xorshift generator, so every run spawns the same tokens.
+struct Random {
+    uint64_t state = 0x9E3779B97F4A7C15ull;
+    uint64_t next() { state ^= state << 13; state ^= state >> 7; state ^= state << 17; return state; }
+    float unit() { return float(next() >> 40) / float(1 << 24); }
+    size_t below(size_t n) { return size_t(next() % n); }
+};
+
+// One sample of the timeline a run records.
+struct Sample {
+    size_t frame;
+    size_t tokens;
+    size_t spawned;   // Tokens spawned since the run started.
+    size_t destroyed; // Tokens destroyed since the run started.
+    size_t live;      // Heap bytes in use.
+    double ms;        // The duration of the sampled frame.
+};
+
+// The outcome of one run.
+struct Result {
+    std::vector<double> frames; // Frame durations in milliseconds.
+    std::vector<Sample> timeline;
+    size_t tokens = 0;          // The mean live population over the measured frames.
+    size_t spawned = 0;
+    size_t peak = 0;            // Peak heap bytes above the run's starting point.
+};
+
+double percentile(std::vector<double> values, double p) {
+    if (values.empty()) return 0.0;
+    size_t i = std::min(values.size() - 1, size_t(p * double(values.size())));
+    std::nth_element(values.begin(), values.begin() + i, values.end());
+    return values[i];
+}
+#pragma endregion
+
+#pragma region World
+struct Vec2 { float x, y; };
+
+// -----------------------------------------------------------------------------
+// World: The containers and behaviors of one run, and the token churn.
+// Three prefabs give tokens different memberships: units move, think and fight,
+// particles only fall and fade, and props sit still and decay. Every token has a
+// remaining lifetime; the Expire behavior destroys it through a Command_Buffer when
+// the lifetime or its health runs out, and `spawn` refills the population after each
+// frame by cloning the prefabs.
+// -----------------------------------------------------------------------------
+struct World {
+    static constexpr float dt = 1.0f / 60.0f;
+
+    Dense_Datum<Vec2> Position, Velocity;
+    Dense_Datum<float> Heading;
+    Datum<float> Health, Score;
+    Datum<int> Age;               // Frames the token has left to live.
+    Datum<uint32_t> Flags;
+    Shared_Datum<float> Regen;    // Health regained per frame, one pool per faction.
+    Static_Datum<float> Gravity = Static_Datum<float>(9.8f);
+    Static_Datum<float> Drag = Static_Datum<float>(0.02f);
+    Command_Buffer commands;
+
+    Behavior<void()> Fall = { [this] { Fall[Velocity].y -= Fall[Gravity] * dt; } };
+    Behavior<void()> Slow = { [this] { Vec2& v = Slow[Velocity]; float k = 1.0f - Slow[Drag]; v.x *= k; v.y *= k; } };
+    Behavior<void()> Move = { [this] { Vec2& p = Move[Position]; const Vec2& v = Move[Velocity]; p.x += v.x * dt; p.y += v.y * dt; } };
+    Behavior<void()> Bounce = { [this] {
+        Vec2& p = Bounce[Position];
+        if (p.y < 0.0f) { p.y = -p.y; Bounce[Velocity].y *= -0.8f; }
+    } };
+    Behavior<void()> Wrap = { [this] { Vec2& p = Wrap[Position]; p.x -= 1000.0f * std::floor(p.x / 1000.0f); } };
+    Behavior<void()> Heal = { [this] { Heal[Health] += Heal[std::as_const(Regen)]; } };
+    Behavior<void()> Decay = { [this] { Decay[Health] -= 1.0f; } };
+    Behavior<void()> Expire = { [this] {
+        const float* health = Health.find(Expire.context());
+        if (--Expire[Age] <= 0 || (health && *health <= 0.0f)) commands.destroy(Expire.context());
+    } };
+    Behavior<void()> Tally = { [this] { const Vec2& v = Tally[Velocity]; Tally[Score] += std::sqrt(v.x * v.x + v.y * v.y) * dt; } };
+    Behavior<void()> Blink = { [this] { Blink[Flags] ^= 1u; } };
+    Behavior<void()> Think = { [this] { const Vec2& p = Think[Position]; Think[Heading] = std::atan2(500.0f - p.y, 500.0f - p.x); } };
+    Behavior<void()> Steer = { [this] { float h = Steer[Heading]; Vec2& v = Steer[Velocity]; v.x += std::cos(h) * dt; v.y += std::sin(h) * dt; } };
+
+    Token unit, particle, prop; // Declared after the containers, so they leave them before the containers go.
+    Random random;
+    size_t spawned = 0;
+    size_t destroyed = 0;
+
+    World() {
+        Fall.reads(Gravity).writes(Velocity);
+        Slow.reads(Drag).writes(Velocity);
+        Move.reads(Velocity).writes(Position);
+        Bounce.writes(Position, Velocity);
+        Wrap.writes(Position);
+        Heal.reads(Regen).writes(Health);
+        Decay.writes(Health);
+        Expire.reads(Health).writes(Age);
+        Tally.reads(Velocity).writes(Score);
+        Blink.writes(Flags);
+        Think.reads(Position).writes(Heading);
+        Steer.reads(Heading).writes(Velocity);
+
+        unit + Position = Vec2{}; unit + Velocity = Vec2{}; unit + Heading = 0.0f;
+        unit + Health = 100.0f; unit + Score = 0.0f; unit + Age = 0; unit + Regen = 0.5f;
+        unit += Gravity; unit += Drag;
+        for (auto* b : { &Fall, &Slow, &Move, &Bounce, &Wrap, &Heal, &Decay, &Expire, &Tally, &Think, &Steer }) unit += *b;
+
+        particle + Position = Vec2{}; particle + Velocity = Vec2{}; particle + Age = 0; particle + Flags = 0u;
+        particle += Gravity; particle += Drag;
+        for (auto* b : { &Fall, &Slow, &Move, &Bounce, &Expire, &Blink }) particle += *b;
+
+        prop + Position = Vec2{}; prop + Health = 50.0f; prop + Age = 0; prop + Flags = 0u; prop + Regen = 0.1f;
+        for (auto* b : { &Heal, &Decay, &Expire, &Blink }) prop += *b;
+
+        // The prefabs only exist to be cloned, so they sleep through every broadcast.
+        for (Token* prefab : { &unit, &particle, &prop })
+            for (auto* b : behaviors()) if (b->contains(*prefab)) b->sleep(*prefab);
+    }
+
+    ~World() { clear(); }
+
+    // Every behavior, in the order a frame runs them.
+    std::array<Behavior<void()>*, 12> behaviors() {
+        return { &Think, &Steer, &Fall, &Slow, &Move, &Bounce, &Wrap, &Tally, &Heal, &Decay, &Blink, &Expire };
+    }
+
+    // The live population; every spawned token has an Age.
+    size_t size() const { return Age.data.size() - 3; }
+
+    // Spawns `count` tokens: half units, a third particles and the rest props, with
+    // random positions, velocities and lifetimes.
+    void spawn(size_t count) {
+        std::vector<size_t> ids(count);
+        for (size_t& id : ids) id = Token_Registry::global().create();
+        size_t units = count / 2, particles = count / 3;
+        std::span<const size_t> all(ids);
+        Token::clone(unit, all.subspan(0, units));
+        Token::clone(particle, all.subspan(units, particles));
+        Token::clone(prop, all.subspan(units + particles));
+        for (size_t id : ids) {
+            if (Vec2* p = Position.find(id)) *p = { random.unit() * 1000.0f, random.unit() * 1000.0f };
+            if (Vec2* v = Velocity.find(id)) *v = { random.unit() * 20.0f - 10.0f, random.unit() * 20.0f - 10.0f };
+            Age[id] = int(1 + random.below(2 * options.lifetime));
+        }
+        spawned += count;
+    }
+
+    // Runs one frame of every behavior, then applies the deaths and refills the population.
+    void frame(Mode mode, Thread_Pool* pool, Scheduler* scheduler, size_t target) {
+        if (mode == Mode::Serial) for (auto* b : behaviors()) (*b)();
+        else if (mode == Mode::Parallel) for (auto* b : behaviors()) b->parallel(*pool);
+        else scheduler->run(*pool);
+        size_t before = size();
+        commands.flush();
+        destroyed += before - size();
+        if (size() < target) spawn(target - size());
+    }
+
+    // Registers the behaviors with a scheduler, each broadcasting across the pool.
+    void schedule(Scheduler& scheduler, Thread_Pool& pool) {
+        scheduler.add("think", Think, pool);
+        scheduler.add("steer", Steer, pool);
+        scheduler.add("fall", Fall, pool);
+        scheduler.add("slow", Slow, pool);
+        scheduler.add("move", Move, pool);
+        scheduler.add("bounce", Bounce, pool);
+        scheduler.add("wrap", Wrap, pool);
+        scheduler.add("tally", Tally, pool);
+        scheduler.add("heal", Heal, pool);
+        scheduler.add("decay", Decay, pool);
+        scheduler.add("blink", Blink, pool);
+        scheduler.add("expire", Expire, pool);
+    }
+
+    // Destroys every spawned token.
+    void clear() {
+        std::vector<size_t> ids;
+        ids.reserve(Age.data.size());
+        for (auto& [token, age] : Age.data) if (token != unit.self && token != particle.self && token != prop.self) ids.push_back(token);
+        Token::destroy(ids);
+    }
+};
+#pragma endregion
+
+#pragma region Runs
+// Fills a world with `tokens` tokens, runs a few unmeasured frames so the containers
+// reach their steady size, then measures `options.frames` frames.
+Result run(Mode mode, size_t tokens, Thread_Pool* pool) {
+    Result result;
+    heap::peak.store(heap::live.load());
+    size_t base = heap::live.load();
+    {
+        World world;
+        Scheduler scheduler;
+        if (mode == Mode::Scheduled) world.schedule(scheduler, *pool);
+        world.spawn(tokens);
+        for (size_t i = 0; i < 3; ++i) world.frame(mode, pool, &scheduler, tokens);
+
+        size_t spawned = world.spawned, population = 0;
+        size_t every = std::max<size_t>(1, options.frames / 20);
+        for (size_t f = 0; f < options.frames; ++f) {
+            auto start = std::chrono::steady_clock::now();
+            world.frame(mode, pool, &scheduler, tokens);
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            result.frames.push_back(ms);
+            population += world.size();
+            if (f % every == 0 || f + 1 == options.frames)
+                result.timeline.push_back({ f, world.size(), world.spawned, world.destroyed, heap::live.load(), ms });
+        }
+        result.tokens = population / std::max<size_t>(1, options.frames);
+        result.spawned = world.spawned - spawned;
+    }
+    result.peak = heap::peak.load() - base;
+    return result;
+}
+
+void print(Mode mode, size_t threads, const Result& result, double serial_p50) {
+    double p50 = percentile(result.frames, 0.50);
+    double mean = 0.0;
+    for (double ms : result.frames) mean += ms;
+    mean /= double(std::max<size_t>(1, result.frames.size()));
+    std::printf("%-10s %7zu %10zu %9.3f %9.3f %9.3f %9.3f %9.2f %10.0f %10.2f %8.2f\n",
+        mode_names[size_t(mode)], threads, result.tokens,
+        p50, percentile(result.frames, 0.90), percentile(result.frames, 0.99),
+        *std::max_element(result.frames.begin(), result.frames.end()),
+        mean * 1e6 / double(std::max<size_t>(1, result.tokens)),
+        double(result.spawned) / double(std::max<size_t>(1, result.frames.size())),
+        heap::mib(result.peak), serial_p50 > 0.0 ? serial_p50 / p50 : 0.0);
+    std::fflush(stdout);
+}
+#pragma endregion
+
+int main(int argc, char** argv)
+{
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (!std::strcmp(argv[i], "--min")) options.min = std::strtoull(argv[i + 1], nullptr, 10);
+        else if (!std::strcmp(argv[i], "--max")) options.max = std::strtoull(argv[i + 1], nullptr, 10);
+        else if (!std::strcmp(argv[i], "--frames")) options.frames = std::strtoull(argv[i + 1], nullptr, 10);
+        else if (!std::strcmp(argv[i], "--threads")) options.threads = std::strtoull(argv[i + 1], nullptr, 10);
+        else if (!std::strcmp(argv[i], "--lifetime")) options.lifetime = std::strtoull(argv[i + 1], nullptr, 10);
+        else if (!std::strcmp(argv[i], "--mode")) options.mode = argv[i + 1];
+    }
+    options.frames = std::max<size_t>(1, options.frames);
+    options.lifetime = std::max<size_t>(1, options.lifetime);
+
+    // One pool per thread count, made up front so thread startup stays out of the timings.
+    std::vector<size_t> counts;
+    for (size_t t = 1; t < options.threads; t *= 2) counts.push_back(t);
+    counts.push_back(std::max<size_t>(1, options.threads));
+    std::vector<std::unique_ptr<Thread_Pool>> pools;
+    for (size_t t : counts) pools.push_back(std::make_unique<Thread_Pool>(t - 1));
+
+    auto selected = [](Mode mode) { return options.mode.empty() || std::string(mode_names[size_t(mode)]).find(options.mode) != std::string::npos; };
+
+    std::printf("%-10s %7s %10s %9s %9s %9s %9s %9s %10s %10s %8s\n",
+        "mode", "threads", "tokens", "p50 ms", "p90 ms", "p99 ms", "max ms", "ns/token", "spawn/fr", "peak MiB", "speedup");
+    Result last;
+    for (size_t n = options.min; n <= options.max; n *= 10) {
+        double serial = 0.0;
+        if (selected(Mode::Serial)) {
+            last = run(Mode::Serial, n, nullptr);
+            serial = percentile(last.frames, 0.50);
+            print(Mode::Serial, 1, last, serial);
+        }
+        for (Mode mode : { Mode::Parallel, Mode::Scheduled }) {
+            if (!selected(mode)) continue;
+            for (size_t i = 0; i < counts.size(); ++i) {
+                last = run(mode, n, pools[i].get());
+                print(mode, counts[i], last, serial);
+            }
+        }
+    }
+
+    std::printf("\n%8s %10s %12s %12s %10s %9s\n", "frame", "tokens", "spawned", "destroyed", "live MiB", "ms");
+    for (const Sample& s : last.timeline)
+        std::printf("%8zu %10zu %12zu %12zu %10.2f %9.3f\n", s.frame, s.tokens, s.spawned, s.destroyed, heap::mib(s.live), s.ms);
+}
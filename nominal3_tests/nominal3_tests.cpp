@@ -0,0 +1,781 @@
+// nominal3_tests.cpp : Regression tests for the token containers and add-ons.
+//
+// Usage: nominal3_tests
+// Runs every test and prints one line per failed check; the exit code is the number of failures.
+
+#include <cstdio>
+#include "../nominal3/nominal.async.h"
+#include "../nominal3/nominal.delta.h"
+#include "../nominal3/nominal.index.h"
+#include "../nominal3/nominal.scheduler.h"
+#include "../nominal3/nominal.snapshot.h"
+#include "../nominal3/nominal.v.3.0.h"
+
+#pragma region Harness
+int failures = 0;
+
+// Records a failed check without stopping the test.
+#define CHECK(condition) do { if (!(condition)) { ++failures; std::printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); } } while (0)
+#pragma endregion
+
+#pragma region Identity
+// Destroying a token bumps its slot's generation: the slot is reused, the old ID stays dead.
+void test_token_registry_generations() {
+    Token_Registry registry;
+    size_t a = registry.create(), b = registry.create();
+    CHECK(a && b && a != b && registry.alive(a) && registry.alive(b));
+    CHECK(Token_Registry::generation_of(a) == 0 && registry.capacity() == 3);
+    registry.destroy(a);
+    CHECK(!registry.alive(a) && registry.alive(b) && registry.generation_at(Token_Registry::index_of(a)) == 1);
+    CHECK(registry.free_slots().size() == 1);
+    size_t reused = registry.create();
+    CHECK(Token_Registry::index_of(reused) == Token_Registry::index_of(a) && Token_Registry::generation_of(reused) == 1);
+    CHECK(registry.alive(reused) && !registry.alive(a) && registry.capacity() == 3);
+    registry.destroy(a); // Stale: must not retire the slot's new owner.
+    CHECK(registry.alive(reused) && registry.free_slots().empty());
+    CHECK(!registry.alive(0) && !registry.alive(registry.capacity()));
+}
+
+// Destroying a token removes it from every datum and behavior, and only that token.
+void test_token_destroy_cascade() {
+    Datum<int> health;
+    Dense_Datum<float> speed;
+    Shared_Datum<int> team;
+    Behavior<void()> Tick = { [] {} };
+    Token doomed, kept;
+    health[doomed] = 1;
+    health[kept] = 2;
+    speed[doomed] = 1.0f;
+    team.join(doomed, team.create(7));
+    doomed += Tick;
+    kept += Tick;
+    size_t id = doomed;
+    doomed.destroy();
+    CHECK(!doomed.alive() && kept.alive());
+    CHECK(!health.contains(id) && !speed.contains(id) && !team.contains(id) && !Tick.contains(id));
+    CHECK(health.contains(kept) && Tick.contains(kept) && team.live() == 0);
+    std::vector<size_t> batch = { Token_Registry::global().create(), Token_Registry::global().create() };
+    for (size_t token : batch) health[token] = 3;
+    Token::destroy(batch);
+    CHECK(health.data.size() == 1 && !Token_Registry::global().alive(batch[0]) && !Token_Registry::global().alive(batch[1]));
+}
+
+// Cloning copies a token's values and subscriptions; describe lists only its containers.
+void test_token_clone_and_describe() {
+    Datum<int> health;
+    Datum<std::string> label;
+    Shared_Datum<int> team;
+    Behavior<void()> Tick = { [] {} };
+    health.named("health");
+    label.named("label");
+    Token prefab, other;
+    health[prefab] = 10;
+    team.join(prefab, team.create(3));
+    prefab += Tick;
+    label[other] = "other";
+    Token copy = prefab.clone();
+    CHECK(copy.alive() && copy.self != prefab.self);
+    CHECK(*health.find(copy) == 10 && Tick.contains(copy) && !label.contains(copy));
+    CHECK(team.pools[copy] == team.pools[prefab] && team.live() == 1);
+    health[copy] = 11;
+    CHECK(*health.find(prefab) == 10);
+    std::vector<size_t> spawned = { Token_Registry::global().create(), Token_Registry::global().create() };
+    Token::clone(prefab, spawned);
+    CHECK(*health.find(spawned[1]) == 10 && Tick.contains(spawned[0]));
+    std::string text = other.describe();
+    CHECK(text == "label: \"other\"\n");
+    CHECK(prefab.describe().find("health: 10\n") != std::string::npos);
+    Token::destroy(spawned);
+}
+#pragma endregion
+
+#pragma region Token Sets
+// Partitions stay contiguous through moves and erases, and sort one at a time.
+void test_token_set_partitions() {
+    Token_Set set;
+    for (size_t token : { 4, 1, 3, 2, 5 }) set.insert(token);
+    set.partition(3);
+    CHECK(set.partitions() == 3 && set.members(0).size() == 5 && set.members(2).empty());
+    CHECK(set.move(3, 2) && set.move(1, 1) && set.move(5, 2) && !set.move(9, 1));
+    CHECK(set.partition_of(3) == 2 && set.partition_of(1) == 1 && set.partition_of(4) == 0 && set.partition_of(9) == Token_Set::npos);
+    CHECK(set.members(0).size() == 2 && set.members(1).size() == 1 && set.members(2).size() == 2);
+    set.insert(6); // New tokens join partition 0.
+    CHECK(set.partition_of(6) == 0 && set.members(0).size() == 3);
+    set.sort(2);
+    CHECK(set.members(2)[0] == 3 && set.members(2)[1] == 5);
+    set.erase(4);
+    CHECK(!set.contains(4) && set.size() == 5 && set.partition_of(6) == 0 && set.partition_of(5) == 2);
+    set.sort();
+    for (size_t p = 0; p < set.partitions(); ++p) {
+        std::span<const size_t> members = set.members(p);
+        CHECK(std::is_sorted(members.begin(), members.end()));
+        for (size_t token : members) CHECK(set.partition_of(token) == p);
+    }
+    CHECK(set.move(3, 0) && set.partition_of(3) == 0 && set.members(2).size() == 1);
+    set.partition(1);
+    CHECK(set.partitions() == 1 && set.size() == 5);
+}
+
+// Sleeping subscribers keep their subscription but skip broadcasts until they wake.
+void test_behavior_sleep_and_wake() {
+    std::vector<size_t> ran;
+    Behavior<void()> Think = { [&] { ran.push_back(Think.context()); } };
+    size_t a = 1, b = 2, c = 3;
+    a += Think;
+    b += Think;
+    c += Think;
+    Think.sleep(b);
+    CHECK(Think.contains(b) && !Think.awake(b) && Think.awake(a));
+    Think();
+    CHECK(ran == std::vector<size_t>({ 1, 3 }));
+    ran.clear();
+    Think.run(1);
+    CHECK(ran == std::vector<size_t>({ 2 }));
+    Think.wake(b);
+    ran.clear();
+    Think();
+    CHECK(ran == std::vector<size_t>({ 1, 2, 3 }));
+}
+#pragma endregion
+
+#pragma region Datums
+static_assert(std::is_copy_assignable_v<Datum<int>>);
+static_assert(std::is_copy_assignable_v<Dense_Datum<int>>);
+static_assert(std::is_copy_assignable_v<Shared_Datum<int>>);
+static_assert(std::is_copy_assignable_v<Paged_Datum<int>>);
+
+// Assigning a tracked datum copies its values and its change history.
+void test_datum_copy_assignment() {
+    Datum<int> source, copy;
+    size_t a = 1, b = 2;
+    source.track();
+    source[a] = 3;
+    copy[b] = 4;
+    copy = source;
+    CHECK(copy.contains(a) && !copy.contains(b) && *copy.find(a) == 3);
+    CHECK(copy.log.enabled && copy.log.version == source.log.version);
+    size_t changes = 0;
+    copy.log.since(0, [&](size_t, Change_Log::Kind) { ++changes; });
+    CHECK(changes == 1);
+}
+
+// A Paged_Datum copy owns its pages: writes to either side stay on that side.
+void test_paged_datum_copy() {
+    Paged_Datum<std::string> source;
+    size_t a = 1, b = 70000;
+    source[a] = "one";
+    source[b] = "far";
+    Paged_Datum<std::string> copy(source), assigned;
+    assigned[a] = "old";
+    assigned = source;
+    copy[a] = "changed";
+    CHECK(*source.find(a) == "one" && *copy.find(a) == "changed");
+    CHECK(*assigned.find(a) == "one" && *assigned.find(b) == "far");
+    CHECK(copy.size() == 2 && assigned.size() == 2);
+    assigned.erase(b);
+    CHECK(source.contains(b) && !assigned.contains(b));
+}
+
+// Reads through a const Shared_Datum leave its pool log alone; writes still show up.
+void test_shared_datum_const_reads() {
+    Shared_Datum<int> regen;
+    size_t a = 1, b = 2;
+    regen.track();
+    regen.join(a, regen.create(5));
+    size_t version = regen.pool_log.version;
+    const Shared_Datum<int>& view = regen;
+    CHECK(view[a] == 5 && view[b] == 0 && view.value(regen.pools[a]) == 5);
+    Behavior<void()> Heal = { [&] { CHECK(Heal[std::as_const(regen)] == 5); } };
+    a += Heal;
+    Heal();
+    CHECK(regen.pool_log.version == version);
+    CHECK(a - regen == 5 && regen.pool_log.size() == 1); // Only the pool's creation and reclaim.
+}
+
+// Equal values intern into one pool; the last token to leave reclaims it for reuse.
+void test_shared_datum_intern_and_reclaim() {
+    Shared_Datum<std::string> faction;
+    size_t a = 1, b = 2, c = 3;
+    size_t red = faction.intern(a, "red");
+    CHECK(faction.intern(b, "red") == red && faction.refs[red - 1] == 2);
+    size_t blue = faction.intern(c, "blue");
+    CHECK(blue != red && faction.live() == 2 && faction[c] == "blue");
+    faction.leave(a);
+    CHECK(faction.live() == 2 && *faction.find(b) == "red");
+    faction.leave(b);
+    CHECK(faction.live() == 1 && !faction.contains(b) && faction.free.size() == 1);
+    CHECK(faction.data[red - 1].empty() && faction.interned.count(std::hash<std::string>{}("red")) == 0);
+    size_t green = faction.intern(a, "green");
+    CHECK(green == red && faction.data.size() == 2 && faction[a] == "green");
+    CHECK(faction.intern(b, "red") != red && faction.live() == 3);
+    faction.join(b, blue);
+    CHECK(faction.live() == 2 && faction.refs[blue - 1] == 2);
+}
+
+struct Vec3 { float x, y, z; };
+
+// The invalid token's row reads as zero and never touches the columns.
+void test_soa_datum_invalid_row() {
+    Soa_Datum<Vec3, &Vec3::x, &Vec3::y, &Vec3::z> position;
+    size_t none = 0, a = 1;
+    CHECK(position[none].get<1>() == 0.0f);
+    position[none] = Vec3{ 1, 2, 3 };
+    CHECK(Vec3(position[none]).x == 0.0f && position.size() == 0);
+    position[a] = Vec3{ 4, 5, 6 };
+    CHECK(position[a].get<2>() == 6.0f && position[none].get<2>() == 0.0f);
+}
+#pragma endregion
+
+#pragma region Concurrent Datums
+// Updates from several threads all land, and reads never create entries.
+void test_concurrent_datum_updates() {
+    Concurrent_Datum<int> hits;
+    size_t missing = 999;
+    std::atomic<size_t> wrong = 0; // Checked after the join, so CHECK never runs on two threads at once.
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < 4; ++t) {
+        threads.emplace_back([&] {
+            for (size_t i = 0; i < 1000; ++i) {
+                hits.update(1 + i % 10, [](int& v) { ++v; });
+                if (int(hits[missing]) != 0) ++wrong;
+            }
+        });
+    }
+    for (std::thread& thread : threads) thread.join();
+    CHECK(wrong == 0);
+    for (size_t token = 1; token <= 10; ++token) CHECK(hits.find(token) == 400);
+    CHECK(!hits.contains(missing) && !hits.find(missing));
+
+    bool seen = hits.read(1, [](const int& v) { CHECK(v == 400); });
+    CHECK(seen && !hits.read(missing, [](const int&) { CHECK(false); }));
+    CHECK(hits.take(1) == 400 && !hits.contains(1));
+    std::vector<size_t> gone = { 2, 3, missing };
+    hits.erase(gone);
+    CHECK(!hits.contains(2) && !hits.contains(3) && hits.contains(4));
+}
+// Readers see the last published frame; writes and erases reach them at the next publish.
+void test_buffered_datum_publish() {
+    Buffered_Datum<int> health;
+    size_t a = 1, b = 2;
+    health[a] = 10;
+    CHECK(health.read().size() == 0 && health.read().frame() == 0);
+    CHECK(health.publish() == 1);
+    health[a] = 11; // Lands in the back copy only.
+    health[b] = 20;
+    {
+        Buffered_Datum<int>::View view = health.read();
+        CHECK(view.frame() == 1 && *view.find(a) == 10 && !view.contains(b));
+    }
+    health.publish();
+    health.erase(a);
+    {
+        Buffered_Datum<int>::View view = health.read();
+        CHECK(view.frame() == 2 && *view.find(a) == 11 && *view.find(b) == 20);
+        CHECK(health.find(b) && *health.find(b) == 20); // The new back copy caught up with frame 2.
+    }
+    health.publish();
+    CHECK(!health.read().contains(a) && health.read().contains(b));
+
+    Buffered_Datum<int, 3> lagging;
+    lagging[a] = 1;
+    lagging.publish();
+    Buffered_Datum<int, 3>::View pinned = lagging.read();
+    lagging[a] = 2;
+    lagging.publish(); // Skips the pinned copy instead of waiting for it.
+    lagging[a] = 3;
+    lagging.publish();
+    CHECK(*pinned.find(a) == 1 && pinned.frame() == 1);
+    CHECK(*lagging.read().find(a) == 3 && *lagging.find(a) == 3);
+}
+// Counts the allocations made through it, to check which resource a container uses.
+struct Counting_Resource : std::pmr::memory_resource {
+    size_t allocations = 0;
+
+    void* do_allocate(size_t bytes, size_t align) override { ++allocations; return std::pmr::new_delete_resource()->allocate(bytes, align); }
+    void do_deallocate(void* p, size_t bytes, size_t align) override { std::pmr::new_delete_resource()->deallocate(p, bytes, align); }
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+};
+
+// Every shard and every copy draws its entries from the resource the datum was given.
+void test_concurrent_datums_use_resource() {
+    Counting_Resource resource;
+    size_t a = 1;
+    Concurrent_Datum<int> hits(&resource);
+    hits.update(a, [](int& v) { v = 1; });
+    CHECK(resource.allocations > 0);
+    size_t before = resource.allocations;
+    Buffered_Datum<int> health(&resource);
+    health[a] = 1;
+    size_t written = resource.allocations;
+    health.publish(); // Copies the entry into the other buffer's map.
+    CHECK(written > before && resource.allocations > written);
+}
+#pragma endregion
+
+#pragma region Archetypes
+using Wide_Archetype = Archetype<std::string, std::array<int, 1024>>;
+static_assert(Wide_Archetype::rows == 2, "Rows are sized so the test spans several chunks.");
+
+// Erasing a row moves the last row into the hole, across chunks, values and all.
+void test_archetype_chunk_moves() {
+    Wide_Archetype crate;
+    auto& [name, payload] = crate.columns;
+    std::vector<size_t> ids = { 1, 2, 3, 4, 5 };
+    for (size_t token : ids) {
+        crate.insert(token);
+        name[token] = "crate " + std::to_string(token);
+        payload[token][0] = int(token);
+    }
+    CHECK(crate.size() == 5 && crate.chunk_count() == 3 && crate.chunks.size() == 3);
+    size_t first = 1, last = 5;
+    crate.erase(first);
+    CHECK(!crate.contains(first) && crate.tokens.index(last) == 0);
+    CHECK(name[last] == "crate 5" && payload[last][0] == 5 && crate.chunk_count() == 2);
+    CHECK(crate.at<0>(4).empty() && crate.at<1>(4)[0] == 0); // The vacated row holds nothing.
+    for (size_t token : { size_t(2), size_t(3), size_t(4) }) CHECK(name[token] == "crate " + std::to_string(token));
+    CHECK(name.chunk(1).size() == 2 && name.chunk(1)[0] == "crate 3");
+    size_t missing = 1;
+    CHECK(name[missing].empty() && !name.find(missing));
+    size_t copy = 6;
+    crate.clone(last, std::span<const size_t>(&copy, 1));
+    CHECK(name[copy] == "crate 5" && payload[copy][0] == 5 && crate.chunk_count() == 3);
+}
+#pragma endregion
+
+#pragma region Threads
+// Behaviors check `depth` before creating entries, so it must cover every chunk.
+void test_thread_pool_depth() {
+    for (size_t workers : { size_t(0), size_t(2) }) {
+        Thread_Pool pool(workers);
+        std::atomic<size_t> outside = 0;
+        pool.parallel_for(1000, 10, [&](size_t, size_t) { if (!Thread_Pool::depth()) ++outside; });
+        CHECK(outside == 0);
+        CHECK(Thread_Pool::depth() == 0);
+    }
+}
+
+// Destroyed pools give their lanes back, so pools made in a loop reuse the same ones.
+void test_thread_pool_lane_reuse() {
+    size_t before = Thread_Pool::lanes();
+    Behavior<void()> Count = { [] {} };
+    for (size_t token = 1; token <= 64; ++token) Count.insert(token);
+    for (size_t round = 0; round < 100; ++round) {
+        Thread_Pool pool(3);
+        Count.parallel(pool);
+    }
+    CHECK(Thread_Pool::lanes() <= before + 3);
+}
+#pragma endregion
+
+#pragma region Commands
+// Threads outside any pool record into lanes of their own, so they can record at once.
+void test_command_buffer_plain_threads() {
+    Command_Buffer commands;
+    Datum<int> value;
+    size_t per_thread = 2000;
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < 4; ++t) {
+        threads.emplace_back([&, t] {
+            for (size_t i = 1; i <= per_thread; ++i) commands.assign(t * per_thread + i, value, int(t));
+        });
+    }
+    for (std::thread& thread : threads) thread.join();
+    CHECK(commands.flush() == 4 * per_thread);
+    CHECK(value.data.size() == 4 * per_thread);
+    CHECK(*value.find(1) == 0 && *value.find(4 * per_thread) == 3);
+}
+
+// A flush subscribes and assigns, then moves, then erases, then destroys, whatever the recording order.
+void test_command_buffer_flush_order() {
+    Command_Buffer commands;
+    Dense_Datum<int> score;
+    Behavior<void()> Think = { [] {} };
+    Think.partition(2);
+    Token parked, dropped, doomed;
+    commands.erase(dropped, Think);
+    commands.move(parked, Think, 1);
+    commands.destroy(doomed);
+    commands.subscribe(parked, Think);
+    commands.subscribe(dropped, Think);
+    commands.assign(doomed, score, 1);
+    CHECK(!Think.contains(parked) && !score.contains(doomed)); // Nothing happens before the flush.
+    CHECK(commands.flush() == 6);
+    CHECK(Think.contains(parked) && !Think.awake(parked) && !Think.contains(dropped));
+    CHECK(!doomed.alive() && !score.contains(doomed));
+    CHECK(commands.flush() == 0);
+}
+
+// Repeated assignments to one token keep the last one recorded, sorted or not.
+void test_command_buffer_last_write_wins() {
+    Command_Buffer commands;
+    Dense_Datum<int> dense;
+    Datum<int> hashed;
+    size_t a = 5, b = 2;
+    for (int value : { 1, 2, 3 }) {
+        commands.assign(a, dense, value);
+        commands.assign(b, dense, value * 10);
+        commands.assign(a, hashed, value);
+    }
+    commands.flush();
+    CHECK(dense[a] == 3 && dense[b] == 30 && dense.size() == 2);
+    CHECK(dense.tokens.dense[0] == b && hashed[a] == 3);
+}
+#pragma endregion
+
+#pragma region Async Behaviors
+// Tasks suspend on values and frames, resume at the next poll, and are dropped when their token leaves.
+void test_async_behavior_suspend_resume() {
+    Datum<int> loaded;
+    std::vector<Async_Value<int>> requests(3);
+    Async_Behavior<void()> Load = { [&]() -> Async_Task {
+        int value = co_await requests[Load.context()];
+        co_await next_frame;
+        Load[loaded] = value;
+    } };
+    size_t a = 1, b = 2;
+    a += Load;
+    b += Load;
+    CHECK(Load() == 2 && Load.busy(a) && Load.busy(b)); // Both wait on their requests.
+    requests[a].set(5);
+    CHECK(Load.poll() == 2 && !loaded.contains(a)); // Resumed, then parked until the next frame.
+    CHECK(Load.poll() == 1 && *loaded.find(a) == 5 && !Load.busy(a));
+    b -= Load;
+    CHECK(Load.in_flight() == 0 && !Load.busy(b));
+    requests[b].set(7);
+    Load.poll();
+    CHECK(!loaded.contains(b)); // The orphaned task was dropped, not resumed.
+    loaded[a] = 0;
+    CHECK(Load() == 1 && Load.busy(a)); // A ready value carries on at once, up to the frame boundary.
+    CHECK(Load.poll() == 0 && *loaded.find(a) == 5);
+}
+#pragma endregion
+
+#pragma region Scheduling
+// Access declared after `add` is honored by the next plan, even one already cached.
+void test_scheduler_live_access() {
+    Datum<int> position, velocity;
+    Behavior<void()> Move = { [] {} };
+    Behavior<void()> Render = { [] {} };
+    Move.reads(velocity);
+    Render.reads(velocity);
+    Scheduler frame;
+    frame.add("move", Move);
+    frame.add("render", Render);
+    frame.run();
+    CHECK(frame.plan().stages.size() == 1);
+
+    Move.writes(position);
+    Render.reads(position);
+    CHECK(frame.plan().stages.size() == 2);
+    frame.run();
+    CHECK(frame.systems[0].runs == 2 && frame.systems[1].runs == 2);
+}
+#pragma endregion
+
+#pragma region Change Logs
+// Readers that follow a log let it forget what they all handled, so churn through
+// ever-new IDs does not grow it, while a lagging reader still sees everything it missed.
+void test_change_log_trimmed_under_churn() {
+    Datum<int> health;
+    size_t reacted = 0;
+    Behavior<void()> Watch = { [&] { ++reacted; } };
+    Watch.watch(health);
+    Delta_Encoder out;
+    out.add(1, health);
+    Ordered_Index by_health(health);
+
+    for (size_t round = 0; round < 1000; ++round) {
+        size_t token = round + 1;
+        health[token] = int(round);
+        health.erase(token);
+        Watch.react();
+        out.flush();
+        CHECK(by_health.size() == 0);
+    }
+    CHECK(reacted == 0); // Removed tokens are not subscribed, so nothing ran.
+    CHECK(health.log.size() <= 1);
+
+    // The encoder falls behind: the log keeps what it has not sent.
+    for (size_t token = 5001; token <= 5100; ++token) health[token] = 1;
+    Watch.react();
+    by_health.refresh();
+    CHECK(health.log.size() == 100);
+    out.flush();
+    CHECK(health.log.size() == 0);
+}
+
+// Readers may poll `version` and advance their cursors while other threads record.
+void test_change_log_version_while_recording() {
+    Change_Log log;
+    log.enabled = true;
+    Change_Log::Cursor seen = log.follow();
+    std::atomic<bool> done = false;
+    std::vector<std::thread> writers;
+    for (size_t t = 0; t < 2; ++t) {
+        writers.emplace_back([&, t] { for (size_t i = 1; i <= 5000; ++i) log.record(t * 5000 + i, Change_Log::Kind::Changed); });
+    }
+    size_t last = 0, backwards = 0;
+    std::thread reader([&] {
+        while (!done) {
+            size_t now = log.version;
+            if (now < last) ++backwards;
+            last = now;
+        }
+    });
+    for (std::thread& writer : writers) writer.join();
+    done = true;
+    reader.join();
+    CHECK(backwards == 0 && log.version == 10000);
+    log.advance(seen);
+    CHECK(*seen == 10000 && log.size() == 0);
+}
+#pragma endregion
+
+#pragma region Queries
+// Walking a Dense_Datum leaves its storage order, and columns taken from it, alone.
+void test_query_keeps_dense_order() {
+    Dense_Datum<int> speed;
+    Datum<int> health;
+    size_t c = 3, a = 1, b = 2;
+    for (size_t token : { c, a, b }) { speed[token] = int(token); health[token] = 0; }
+    std::span<int> column(speed.data.data(), speed.size());
+    std::vector<size_t> visited;
+    Query(speed, health).each([&](size_t token, int& s, int&) { visited.push_back(token); CHECK(s == int(token)); });
+    CHECK((visited == std::vector<size_t>{ c, a, b }));
+    CHECK(speed.tokens.dense[0] == c && column[0] == 3 && column.data() == speed.data.data());
+}
+#pragma endregion
+
+#pragma region Indexes
+// Points and boxes far out, infinite or NaN map to clamped cells instead of overflowing the cast.
+void test_grid_index_extreme_points() {
+    using Point = std::array<float, 2>;
+    const float inf = std::numeric_limits<float>::infinity(), nan = std::numeric_limits<float>::quiet_NaN();
+    Datum<Point> place;
+    Grid_Index by_place(place, 4.0f, [](const Point& p) { return p; });
+    size_t near = 1, far = 2, endless = 3, lost = 4;
+    place[near] = Point{ 1, 1 };
+    place[far] = Point{ 1e30f, 0 };
+    place[endless] = Point{ inf, 0 };
+    place[lost] = Point{ nan, 0 };
+    CHECK(by_place.size() == 4);
+    CHECK(by_place.within(Point{ 0, 0 }, Point{ 2, 2 }).size() == 1);
+    auto& out = by_place.within(Point{ 1e29f, -1 }, Point{ inf, 1 });
+    CHECK(out.size() == 2 && out.contains(far) && out.contains(endless));
+    CHECK(by_place.within(Point{ -inf, -inf }, Point{ inf, inf }).size() == 3);
+    CHECK(by_place.within(Point{ nan, 0 }, Point{ 2, 2 }).empty());
+    CHECK(by_place.near(Point{ nan, nan }, 1.0f).empty());
+    place.erase(lost);
+    by_place.refresh();
+    CHECK(by_place.size() == 3);
+}
+#pragma endregion
+
+#pragma region Deltas
+// A leader that reclaims a pool and reuses its ID within one tick: the follower must
+// end up with the new value in that pool, and with the pool still in use.
+void test_delta_pool_reuse() {
+    Shared_Datum<int> leader, follower;
+    size_t a = 1001, b = 1002;
+    Delta_Encoder out;
+    Delta_Decoder in;
+    out.add(1, leader);
+    in.add(1, follower);
+
+    leader.join(a, leader.create(5));
+    CHECK(in.apply(out.flush()));
+    CHECK(follower[a] == 5);
+
+    leader.leave(a);
+    size_t pool = leader.create(7);
+    CHECK(pool == 1);
+    leader.join(b, pool);
+    CHECK(in.apply(out.flush()));
+    CHECK(!follower.contains(a));
+    CHECK(follower.contains(b) && follower[b] == 7);
+    CHECK(follower.live() == leader.live());
+
+    // A new pool on the follower must not take over B's.
+    CHECK(follower.create(9) != follower.pools[b]);
+    CHECK(follower[b] == 7);
+}
+
+// A token moving out of a pool that is reclaimed and reused for another token in the same tick.
+void test_delta_pool_reuse_on_move() {
+    Shared_Datum<int> leader, follower;
+    size_t a = 1001, b = 1002;
+    Delta_Encoder out;
+    Delta_Decoder in;
+    out.add(1, leader);
+    in.add(1, follower);
+
+    size_t first = leader.create(1);
+    leader.join(a, first);
+    size_t second = leader.create(2);
+    CHECK(in.apply(out.flush()));
+
+    leader.join(a, second);
+    leader.join(b, leader.create(3));
+    CHECK(in.apply(out.flush()));
+    CHECK(follower[a] == 2);
+    CHECK(follower[b] == 3);
+    CHECK(follower.pools[b] == first);
+    CHECK(follower.live() == leader.live());
+}
+
+// Old members leaving a pool before a new one joins it must not reclaim it on the follower.
+void test_delta_join_after_leave() {
+    Shared_Datum<int> leader, follower;
+    size_t a = 1001, b = 1002;
+    Delta_Encoder out;
+    Delta_Decoder in;
+    out.add(1, leader);
+    in.add(1, follower);
+
+    size_t pool = leader.create(4);
+    leader.join(a, pool);
+    CHECK(in.apply(out.flush()));
+
+    leader.join(b, pool);
+    leader.leave(a);
+    CHECK(in.apply(out.flush()));
+    CHECK(follower[b] == 4 && follower.refs[pool - 1] == 1);
+    CHECK(follower.free.empty() && follower.live() == leader.live());
+}
+
+// A join into a pool the follower does not have, or has reclaimed, rejects the batch.
+void test_delta_join_unknown_pool() {
+    Shared_Datum<int> follower;
+    size_t a = 1001, b = 1002, c = 1003;
+    Delta_Decoder in;
+    in.add(1, follower);
+    follower.join(a, follower.create(5));
+    follower.join(b, follower.create(6));
+    follower.leave(b); // Reclaims pool 2.
+    for (uint64_t pool : { 2, 3 }) {
+        std::vector<uint8_t> message;
+        delta::put_varint(message, 1);
+        message.push_back(uint8_t(delta::Form::Pools));
+        delta::put_varint(message, 0); // No pools placed.
+        delta::put_varint(message, 1);
+        delta::put_varint(message, c << 1);
+        delta::put_varint(message, pool);
+        CHECK(!in.apply(message));
+        CHECK(!follower.contains(c) && follower.refs[1] == 0 && follower.free.size() == 1);
+    }
+    CHECK(follower[a] == 5 && follower.live() == 1);
+}
+#pragma endregion
+
+#pragma region Snapshots
+const char* snapshot_path = "nominal3_tests.snap";
+
+// A recycled slot's ID has a generation, so ordering by slot is not ordering by ID.
+void test_snapshot_dense_generations() {
+    Dense_Datum<int> datum;
+    size_t recycled = (size_t(1) << Token_Registry::index_bits) | 1, two = 2, three = 3;
+    datum[recycled] = 10; datum[two] = 20; datum[three] = 30;
+    { Snapshot_Writer out(snapshot_path); out.write("dense", datum); CHECK(out.close()); }
+    Snapshot in(snapshot_path);
+    CHECK(bool(in));
+    auto view = in.view<int>("dense");
+    CHECK(view.find(recycled) && *view.find(recycled) == 10);
+    CHECK(view.find(two) && *view.find(two) == 20);
+    CHECK(view.find(three) && *view.find(three) == 30);
+    CHECK(view.contains(recycled) && view.contains(two) && view.contains(three));
+    CHECK(*datum.find(recycled) == 10); // Writing leaves the datum as it was.
+}
+
+// A column whose size is not a multiple of 8 must not misalign the directory.
+void test_snapshot_directory_alignment() {
+    Datum<char> letters;
+    size_t a = 1, b = 2, c = 3;
+    letters[a] = 'a'; letters[b] = 'b'; letters[c] = 'c';
+    { Snapshot_Writer out(snapshot_path); out.write("letters", letters); CHECK(out.close()); }
+    snapshot::Header header;
+    std::FILE* file = std::fopen(snapshot_path, "rb");
+    CHECK(file && std::fread(&header, sizeof(header), 1, file) == 1);
+    if (file) std::fclose(file);
+    CHECK(header.directory % alignof(snapshot::Section) == 0);
+    Snapshot in(snapshot_path);
+    CHECK(bool(in));
+    CHECK(in.view<char>("letters").find(b) && *in.view<char>("letters").find(b) == 'b');
+}
+
+// A section with a bad pool ID is rejected before the datum changes.
+void test_snapshot_shared_corrupt() {
+    Shared_Datum<int> saved, loaded;
+    size_t a = 1, b = 2, c = 3;
+    saved.join(a, saved.create(4));
+    saved.join(b, saved.create(5));
+    { Snapshot_Writer out(snapshot_path); out.write("shared", saved); CHECK(out.close()); }
+
+    loaded.join(c, loaded.create(6));
+    {
+        Snapshot in(snapshot_path);
+        CHECK(in.load("shared", loaded));
+        CHECK(!loaded.contains(c));
+        CHECK(loaded[a] == 4 && loaded[b] == 5);
+        CHECK(Container_Registry::global().describe(c).empty());
+    }
+
+    // Point b at a pool the section does not hold.
+    snapshot::Header header;
+    snapshot::Section section;
+    std::FILE* file = std::fopen(snapshot_path, "r+b");
+    CHECK(file && std::fread(&header, sizeof(header), 1, file) == 1);
+    if (!file) return;
+    std::fseek(file, long(header.directory), SEEK_SET);
+    CHECK(std::fread(&section, sizeof(section), 1, file) == 1);
+    uint64_t bad = 99;
+    std::fseek(file, long(section.extra.offset + sizeof(uint64_t)), SEEK_SET);
+    CHECK(std::fwrite(&bad, sizeof(bad), 1, file) == 1);
+    std::fclose(file);
+
+    Shared_Datum<int> kept;
+    kept.join(c, kept.create(6));
+    Snapshot in(snapshot_path);
+    CHECK(!in.load("shared", kept));
+    CHECK(kept.contains(c) && kept[c] == 6);
+    CHECK(!kept.contains(a) && kept.live() == 1);
+}
+#pragma endregion
+
+int main()
+{
+    test_token_registry_generations();
+    test_token_destroy_cascade();
+    test_token_clone_and_describe();
+    test_token_set_partitions();
+    test_behavior_sleep_and_wake();
+    test_datum_copy_assignment();
+    test_paged_datum_copy();
+    test_shared_datum_const_reads();
+    test_shared_datum_intern_and_reclaim();
+    test_soa_datum_invalid_row();
+    test_concurrent_datum_updates();
+    test_buffered_datum_publish();
+    test_concurrent_datums_use_resource();
+    test_archetype_chunk_moves();
+    test_thread_pool_depth();
+    test_thread_pool_lane_reuse();
+    test_command_buffer_plain_threads();
+    test_command_buffer_flush_order();
+    test_command_buffer_last_write_wins();
+    test_async_behavior_suspend_resume();
+    test_scheduler_live_access();
+    test_change_log_trimmed_under_churn();
+    test_change_log_version_while_recording();
+    test_query_keeps_dense_order();
+    test_grid_index_extreme_points();
+    test_delta_pool_reuse();
+    test_delta_pool_reuse_on_move();
+    test_delta_join_after_leave();
+    test_delta_join_unknown_pool();
+    test_snapshot_dense_generations();
+    test_snapshot_directory_alignment();
+    test_snapshot_shared_corrupt();
+    std::remove(snapshot_path);
+    std::printf(failures ? "%d checks failed\n" : "all checks passed\n", failures);
+    return failures;
+}